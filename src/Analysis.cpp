@@ -0,0 +1,267 @@
+/*
+ * Analysis.cpp
+ *
+ *  Created on: Mar 21, 2016
+ *      Author: derek
+ */
+
+#include "Analysis.h"
+#include "Move.h"
+#include "PositionFile.h"
+#include "Search.h"
+#include "Settings.h"
+#include "State.h"
+#include "ThreadPool.h"
+#include <chrono>
+#include <istream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <utility>
+
+namespace
+{
+
+enum class Input
+{
+	POSITION,
+	BLANK,     // written back as it is
+	UNREADABLE
+};
+
+// What a worker found for one input position, waiting to be written
+struct Analyzed
+{
+	std::string text;
+	bool hasRecord;
+	PositionRecord record;
+};
+
+// Lines of text in State::print() form
+class TextInput
+{
+public:
+	using Item = std::string;
+	explicit TextInput(std::istream& input) : input(input) {}
+
+	bool next(Item& line)
+	{
+		return static_cast<bool>(std::getline(input, line));
+	}
+
+	static Input load(Item& line, State& state, std::ostream& text)
+	{
+		if (!line.empty() && line.back() == '\r')
+		{
+			line.pop_back();
+		}
+		text << line;
+		return line.empty() ? Input::BLANK
+				: parseState(state.getConfig(), line, state)
+				? Input::POSITION : Input::UNREADABLE;
+	}
+private:
+	std::istream& input;
+};
+
+// The records of a position file, loaded where they lie
+class RecordInput
+{
+public:
+	using Item = std::size_t;
+	explicit RecordInput(const PositionFile& input) : input(input), read{0} {}
+
+	bool next(Item& index)
+	{
+		index = read;
+		read += read < input.size();
+		return index < input.size();
+	}
+
+	Input load(Item index, State& state, std::ostream& text) const
+	{
+		if (!loadPosition(input[index], state))
+		{
+			text << "record " << index;
+			return Input::UNREADABLE;
+		}
+		text << state;
+		return Input::POSITION;
+	}
+private:
+	const PositionFile& input;
+	std::size_t read;
+};
+
+// Searches state, deepening to settings.depth or until its time is up, and
+// adds what it found to analyzed. nodesExpanded gets the nodes it took.
+void analyzePosition(SearchContext& context, const AnalysisSettings& settings,
+		const State& state, std::ostream& text, Analyzed& analyzed,
+		long& nodesExpanded)
+{
+	storePosition(state, analyzed.record);
+	analyzed.hasRecord = true;
+	if (state.isEndState())
+	{
+		text << " game-over";
+		return;
+	}
+
+	if (context.transpositionTable)
+	{
+		context.transpositionTable->newSearch();
+	}
+	context.searchId += 1;
+	auto maxDepth = settings.depth;
+	if (settings.moveMilliseconds > 0)
+	{
+		maxDepth = MAX_SEARCH_DEPTH;
+		setSearchDeadline(context, std::chrono::steady_clock::now()
+				+ std::chrono::milliseconds{settings.moveMilliseconds});
+	}
+
+	auto best = SearchResult{};
+	auto depth = 0;
+	for (auto next = 1; next <= maxDepth; ++next)
+	{
+		auto result = searchToDepth(context, state, next,
+				depth > 0 ? best.value : NO_GUESS);
+		nodesExpanded += result.nodesExpanded;
+		if (!result.complete)
+		{
+			break;
+		}
+		best = result;
+		depth = next;
+	}
+	clearSearchDeadline(context);
+	if (depth == 0)
+	{
+		// Out of time before even one move deep
+		best = searchToDepth(context, state, 1);
+		nodesExpanded += best.nodesExpanded;
+		depth = 1;
+	}
+
+	text << " best=";
+	for (auto i = 0; i < best.bestMove.size(); ++i)
+	{
+		text << (i > 0 ? "," : "") << best.bestMove[i];
+	}
+	text << " value=" << best.value << " depth=" << depth << " nodes="
+			<< nodesExpanded;
+	analyzed.record.flags |= POSITION_HAS_SCORE | POSITION_HAS_BEST_MOVE;
+	analyzed.record.score = best.value;
+	analyzed.record.bestMove = encodeMove(best.bestMove.front());
+}
+
+/**
+ * Each worker thread takes the next position for itself and searches it
+ * with a context and transposition table of its own. Finished positions
+ * wait until the ones before them are written, so the output is in input
+ * order, and each is written as soon as it can be.
+ */
+template <typename Source>
+AnalysisTotals analyzeAll(Source& source, std::ostream& output,
+		const GameConfig& config, const AnalysisSettings& settings)
+{
+	auto totals = AnalysisTotals{};
+	std::mutex mutex;
+	auto itemsRead = 0;
+	auto itemsWritten = 0;
+	auto finished = std::map<int, Analyzed>{};
+
+	ThreadPool pool{settings.workers};
+	pool.runOnAll([&](int)
+	{
+		SearchContext context;
+		context.heuristic = settings.heuristic;
+		context.moveOrdering = settings.moveOrdering;
+		context.algorithm = settings.algorithm;
+		context.tablebase = settings.tablebase;
+		auto table = std::unique_ptr<TranspositionTable>{};
+		if (settings.tableMegabytes > 0)
+		{
+			table = std::make_unique<TranspositionTable>(
+					settings.tableMegabytes, settings.tableReplacement);
+			context.transpositionTable = table.get();
+		}
+
+		auto item = typename Source::Item{};
+		auto state = State{config};
+		while (true)
+		{
+			auto number = 0;
+			{
+				std::lock_guard<std::mutex> lock{mutex};
+				if (!source.next(item))
+				{
+					break;
+				}
+				number = itemsRead++;
+			}
+
+			auto text = std::ostringstream{};
+			auto analyzed = Analyzed{};
+			auto nodesExpanded = 0L;
+			const auto input = source.load(item, state, text);
+			if (input == Input::POSITION)
+			{
+				analyzePosition(context, settings, state, text, analyzed,
+						nodesExpanded);
+			}
+			else if (input == Input::UNREADABLE)
+			{
+				text << " unreadable";
+			}
+			analyzed.text = text.str();
+
+			std::lock_guard<std::mutex> lock{mutex};
+			totals.positions += input != Input::BLANK;
+			totals.unreadable += input == Input::UNREADABLE;
+			totals.nodesExpanded += nodesExpanded;
+			finished.emplace(number, std::move(analyzed));
+			for (auto next = finished.begin();
+					next != finished.end() && next->first == itemsWritten;
+					next = finished.erase(next))
+			{
+				output << next->second.text << '\n';
+				if (settings.scored && next->second.hasRecord)
+				{
+					settings.scored->write(next->second.record);
+				}
+				itemsWritten += 1;
+			}
+			output.flush();
+		}
+	});
+	return totals;
+}
+
+}
+
+/**
+ * Searches positions written the way State::print() writes them, one per
+ * line, and writes each line back followed by its best turn, its value for
+ * the player to move, the depth reached and the nodes expanded. Blank lines
+ * are written back as they are.
+ */
+AnalysisTotals analyzePositions(std::istream& input, std::ostream& output,
+		const GameConfig& config, const AnalysisSettings& settings)
+{
+	auto source = TextInput{input};
+	return analyzeAll(source, output, config, settings);
+}
+
+// Likewise for the records of a position file, which are written out in
+// State::print() form
+AnalysisTotals analyzePositions(const PositionFile& input,
+		std::ostream& output, const GameConfig& config,
+		const AnalysisSettings& settings)
+{
+	auto source = RecordInput{input};
+	return analyzeAll(source, output, config, settings);
+}
@@ -0,0 +1,46 @@
+/*
+ * Analysis.h
+ *
+ *  Created on: Mar 21, 2016
+ *      Author: derek
+ */
+
+#ifndef SRC_ANALYSIS_H_
+#define SRC_ANALYSIS_H_
+
+#include "Settings.h"
+#include "TranspositionTable.h"
+#include <cstddef>
+#include <iosfwd>
+class PositionFile;
+class PositionWriter;
+
+struct AnalysisSettings
+{
+	int depth;
+	int workers;
+	long moveMilliseconds;      // if set, deepen until it runs out instead
+	std::size_t tableMegabytes; // for each worker's own table
+	ReplacementPolicy tableReplacement;
+	Heuristic heuristic;
+	Ordering moveOrdering;
+	Algorithm algorithm;
+	const Tablebase* tablebase; // shared by all workers; may be null
+	PositionWriter* scored;     // may be null; gets every position with its
+	                            // score and best move, in input order
+};
+
+struct AnalysisTotals
+{
+	int positions;
+	int unreadable;
+	long nodesExpanded;
+};
+
+AnalysisTotals analyzePositions(std::istream& input, std::ostream& output,
+		const GameConfig& config, const AnalysisSettings& settings);
+AnalysisTotals analyzePositions(const PositionFile& input,
+		std::ostream& output, const GameConfig& config,
+		const AnalysisSettings& settings);
+
+#endif /* SRC_ANALYSIS_H_ */
@@ -0,0 +1,86 @@
+/*
+ * Evaluator.h
+ *
+ *  Created on: Mar 20, 2016
+ *      Author: derek
+ */
+
+#ifndef SRC_EVALUATOR_H_
+#define SRC_EVALUATOR_H_
+
+#include <cstdint>
+class State;
+
+// Which heuristic an AI player scores positions with
+enum class Heuristic : uint8_t
+{
+	H1 = 1, // calculateHeuristic1
+	H2 = 2  // calculateHeuristic2
+};
+
+int calculateHeuristic1(const State& state, bool p1IsMaximizer);
+int calculateHeuristic2(const State& state, bool p1IsMaximizer);
+int solvedHeuristic1(const State& state, int p1Lead, bool ends,
+		bool p1IsMaximizer);
+int solvedHeuristic2(const State& state, int p1Lead, bool ends,
+		bool p1IsMaximizer);
+
+// For the odd score outside a search, where the dispatch doesn't matter
+inline int evaluate(Heuristic heuristic, const State& state,
+		bool p1IsMaximizer)
+{
+	return heuristic == Heuristic::H1
+			? calculateHeuristic1(state, p1IsMaximizer)
+			: calculateHeuristic2(state, p1IsMaximizer);
+}
+
+/**
+ * Evaluators are template arguments of Node and the search loops, so every
+ * heuristic gets a search of its own with the calls resolved at compile
+ * time. The heuristic is picked once per search, in searchToDepth().
+ *
+ * A new evaluator needs a case there, and explicit instantiations next to
+ * the existing ones in Node.cpp, Search.cpp and YoungBrothers.cpp.
+ */
+struct Heuristic1Evaluator
+{
+	static int evaluate(const State& state, bool p1IsMaximizer)
+	{
+		return calculateHeuristic1(state, p1IsMaximizer);
+	}
+
+	// Scores state by its tablebase result, P1 capturing p1Lead more of
+	// the stones left than P2 and the game ending or not
+	static int evaluateSolved(const State& state, int p1Lead, bool ends,
+			bool p1IsMaximizer)
+	{
+		return solvedHeuristic1(state, p1Lead, ends, p1IsMaximizer);
+	}
+
+	// What one more captured stone is worth, to size search windows by
+	static constexpr int stoneValue()
+	{
+		return 2;
+	}
+};
+
+struct Heuristic2Evaluator
+{
+	static int evaluate(const State& state, bool p1IsMaximizer)
+	{
+		return calculateHeuristic2(state, p1IsMaximizer);
+	}
+
+	static int evaluateSolved(const State& state, int p1Lead, bool ends,
+			bool p1IsMaximizer)
+	{
+		return solvedHeuristic2(state, p1Lead, ends, p1IsMaximizer);
+	}
+
+	static constexpr int stoneValue()
+	{
+		return 130 * Heuristic1Evaluator::stoneValue();
+	}
+};
+
+#endif /* SRC_EVALUATOR_H_ */
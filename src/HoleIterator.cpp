@@ -15,6 +15,9 @@
  * clockwise or counterclockwise. Then it takes care of the rest, and all
  * you have to do is call next() and dereference to get a reference to the
  * actual data in the state, which you can read or modify as you please.
+ *
+ * applyMove does not walk the board with this class directly. Instead the
+ * sowing tables in Sowing.cpp are recorded from it once per board size.
  */
 #include "HoleIterator.h"
 #include "State.h"
@@ -26,12 +29,13 @@ HoleIterator::HoleIterator(const Move& move, State& state)
 : currentHole{move.holeNumber},
   state{state},
   clockwise{move.clockwise},
+  numHoles{static_cast<uint8_t>(state.getConfig().numHoles)},
   otherMancala1{0},
   otherMancala2{0},
   myMancala1{0},
   myMancala2{0}
 {
-	assert(move.holeNumber > 0 && move.holeNumber <= globalState().numHoles);
+	assert(move.holeNumber > 0 && move.holeNumber <= numHoles);
 	if (!state.getIsP1Turn())
 	{
 		// Suppose there are 4 holes. Then clockwise hole order goes:
@@ -52,21 +56,21 @@ HoleIterator::HoleIterator(const Move& move, State& state)
 		//
 		// When you do the math, the transformation from move number
 		// to bottom hole is:
-		currentHole += 3 + 2 * (globalState().numHoles - move.holeNumber);
+		currentHole += 3 + 2 * (numHoles - move.holeNumber);
 	}
 
 	if (state.getIsP1Turn())
 	{
-		otherMancala1 = globalState().numHoles + 2;
+		otherMancala1 = numHoles + 2;
 		otherMancala2 = mod() - 1;
 		myMancala1 = 0;
-		myMancala2 = globalState().numHoles + 1;
+		myMancala2 = numHoles + 1;
 	}
 	else
 	{
 		otherMancala1 = 0;
-		otherMancala2 = globalState().numHoles + 1;
-		myMancala1 = globalState().numHoles + 2;
+		otherMancala2 = numHoles + 1;
+		myMancala1 = numHoles + 2;
 		myMancala2 = mod() - 1;
 	}
 }
@@ -108,19 +112,19 @@ uint8_t& HoleIterator::operator*()
 	{
 		if (state.getIsP1Turn())
 		{
-			return state.p1Captures;
+			return state.p1Captures();
 		}
 		else
 		{
-			return state.p2Captures;
+			return state.p2Captures();
 		}
 	}
 	else
 	{
-		if (currentHole >= 1 && currentHole <= globalState().numHoles)
+		if (currentHole >= 1 && currentHole <= numHoles)
 		{
 			// We are in P1 hole range
-			return state.p1Holes[currentHole-1];
+			return state.p1Holes()[currentHole-1];
 		}
 		else
 		{
@@ -140,8 +144,8 @@ uint8_t& HoleIterator::operator*()
 			//
 			// When you do the math, the formula is like so:
 			auto holeIndex = mod()-2-currentHole;
-			assert(holeIndex >= 0 && holeIndex < state.p2Holes.size());
-			return state.p2Holes[holeIndex];
+			assert(holeIndex >= 0 && holeIndex < numHoles);
+			return state.p2Holes()[holeIndex];
 		}
 	}
 }
@@ -158,19 +162,19 @@ uint8_t& HoleIterator::opposite()
 	assert(isOwnHole());
 	if (state.getIsP1Turn())
 	{
-		return state.p2Holes[currentHole-1];
+		return state.p2Holes()[currentHole-1];
 	}
 	else
 	{
 		auto holeIndex = mod()-2-currentHole;
-		assert(holeIndex >= 0 && holeIndex < state.p2Holes.size());
-		return state.p1Holes[holeIndex];
+		assert(holeIndex >= 0 && holeIndex < numHoles);
+		return state.p1Holes()[holeIndex];
 	}
 }
 
 uint8_t HoleIterator::mod() const
 {
-	return globalState().numHoles * 2 + 4;
+	return numHoles * 2 + 4;
 }
 
 bool HoleIterator::isOwnMancala() const
@@ -182,11 +186,11 @@ bool HoleIterator::isOwnHole() const
 {
 	if (state.getIsP1Turn())
 	{
-		return currentHole >= 1 && currentHole <= globalState().numHoles;
+		return currentHole >= 1 && currentHole <= numHoles;
 	}
 	else
 	{
 		return currentHole <= mod() - 2
-				&& currentHole >= globalState().numHoles + 3;
+				&& currentHole >= numHoles + 3;
 	}
 }
@@ -25,6 +25,7 @@ private:
 	uint8_t currentHole;
 	State& state;
 	bool clockwise;
+	uint8_t numHoles;
 	uint8_t mod() const;
 	uint8_t otherMancala1;
 	uint8_t otherMancala2;
@@ -0,0 +1,386 @@
+/*
+ * MonteCarlo.cpp
+ *
+ *  Created on: Mar 21, 2016
+ *      Author: derek
+ */
+
+#include "MonteCarlo.h"
+#include "Move.h"
+#include "Search.h"
+#include "Settings.h"
+#include "State.h"
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <vector>
+
+namespace
+{
+
+// What each thread's tree may grow to when only the clock limits it
+const std::size_t MAX_TREE_NODES = 1 << 20;
+
+// Playouts look at the clock once every PLAYOUT_CLOCK_MASK + 1 playouts
+const int PLAYOUT_CLOCK_MASK = 63;
+
+// Both players can sow around in circles forever, so playouts that get
+// this long are scored as they stand
+const int MAX_PLAYOUT_MOVES = 1000;
+
+// UCT's exploration constant, about sqrt(2) for rewards between 0 and 1
+const double EXPLORATION = 1.414;
+
+// A bonus move with fewer playouts than this is searched again rather than
+// taken straight from the tree
+const uint32_t MIN_TRUSTED_VISITS = 16;
+
+const int32_t NO_CHILDREN = -1;
+
+// One sowing in the tree. A turn with bonus moves is a path of nodes, so
+// the bonus-move branching doesn't multiply out the way it does for turns.
+struct TreeNode
+{
+	int32_t firstChild;  // index in the pool; the children are contiguous
+	uint32_t visits;
+	float wins;          // for the player who made move, ties counting half
+	uint8_t move;        // encodeMove() code of the sowing that led here
+	uint8_t numChildren;
+	bool p1Moved;
+};
+
+// xorshift64*, which is plenty for choosing playout moves and a lot
+// cheaper than the standard engines
+class Random
+{
+public:
+	explicit Random(uint64_t seed) : state{seed | 1} {}
+
+	// A number in [0, n)
+	uint32_t below(uint32_t n)
+	{
+		state ^= state >> 12;
+		state ^= state << 25;
+		state ^= state >> 27;
+		return static_cast<uint32_t>(
+				(state * 2685821657736338717ULL >> 32) * n >> 32);
+	}
+private:
+	uint64_t state;
+};
+
+/**
+ * A UCT search tree of one thread. Its nodes come out of a pool allocated
+ * up front, and once the pool is full, the tree stops growing and the
+ * remaining playouts start from its leaves.
+ */
+class MonteCarloTree
+{
+public:
+	MonteCarloTree(const State& root, std::size_t capacity, uint64_t seed);
+	void playout();
+	const std::vector<TreeNode>& getNodes() const { return nodes; }
+private:
+	const State& root;
+	std::vector<TreeNode> nodes;
+	std::vector<int32_t> path;
+	Random random;
+	bool expand(int32_t index, const State& state);
+	int32_t select(const TreeNode& parent) const;
+	float simulate(State& state);
+};
+
+MonteCarloTree::MonteCarloTree(const State& root, std::size_t capacity,
+		uint64_t seed)
+: root{root},
+  nodes{},
+  path{},
+  random{seed}
+{
+	assert(capacity > 2u * root.getConfig().numHoles);
+	nodes.reserve(capacity);
+	nodes.push_back(TreeNode{NO_CHILDREN, 0, 0, 0, 0, !root.getIsP1Turn()});
+}
+
+// Selects a path down the tree, grows it by one node's children, plays the
+// game out from there and scores the path with the result
+void MonteCarloTree::playout()
+{
+	auto state = root;
+	auto index = 0;
+	path.clear();
+	path.push_back(index);
+	while (!state.isEndState())
+	{
+		// Leaves only get children on their second visit, so that the
+		// positions seen just once don't fill up the pool
+		if (nodes[index].numChildren == 0
+				&& ((index != 0 && nodes[index].visits == 0)
+						|| !expand(index, state)))
+		{
+			break;
+		}
+		index = select(nodes[index]);
+		applyMove(state, decodeMove(nodes[index].move));
+		path.push_back(index);
+	}
+
+	const auto p1Reward = simulate(state);
+	for (auto i : path)
+	{
+		auto& node = nodes[i];
+		node.visits += 1;
+		node.wins += node.p1Moved ? p1Reward : 1 - p1Reward;
+	}
+}
+
+// Gives nodes[index] a child for each sowing from state. Sowing from an
+// empty hole passes whichever hole it is, so there is only one pass among
+// them, and it goes last: ties go to the first child, and a player that
+// has already won mustn't pass forever. Returns false if the pool has no
+// room.
+bool MonteCarloTree::expand(int32_t index, const State& state)
+{
+	const auto numHoles = state.getConfig().numHoles;
+	if (nodes.size() + 2 * numHoles > nodes.capacity())
+	{
+		return false;
+	}
+
+	const auto p1 = state.getIsP1Turn();
+	const auto holes = p1 ? state.p1Holes() : state.p2Holes();
+	const auto first = static_cast<int32_t>(nodes.size());
+	auto pass = 0;
+	for (auto hole = 1; hole <= numHoles; ++hole)
+	{
+		if (holes[hole - 1] == 0)
+		{
+			pass = pass != 0 ? pass : hole;
+			continue;
+		}
+		for (auto clockwise = 0; clockwise <= 1; ++clockwise)
+		{
+			const auto move = Move(hole, clockwise);
+			nodes.push_back(TreeNode{NO_CHILDREN, 0, 0, encodeMove(move),
+					0, p1});
+		}
+	}
+	if (pass != 0)
+	{
+		const auto move = Move(pass, false);
+		nodes.push_back(TreeNode{NO_CHILDREN, 0, 0, encodeMove(move), 0, p1});
+	}
+	nodes[index].firstChild = first;
+	nodes[index].numChildren = nodes.size() - first;
+	return true;
+}
+
+// The child with the best upper confidence bound. Children that haven't
+// been tried yet come first.
+int32_t MonteCarloTree::select(const TreeNode& parent) const
+{
+	const auto logVisits = std::log(static_cast<double>(parent.visits));
+	auto best = parent.firstChild;
+	auto bestBound = -1.0;
+	for (auto i = parent.firstChild;
+			i < parent.firstChild + parent.numChildren; ++i)
+	{
+		const auto& child = nodes[i];
+		if (child.visits == 0)
+		{
+			return i;
+		}
+		const auto bound = child.wins / child.visits
+				+ EXPLORATION * std::sqrt(logVisits / child.visits);
+		if (bound > bestBound)
+		{
+			bestBound = bound;
+			best = i;
+		}
+	}
+	return best;
+}
+
+// Plays state out with random sowings from holes that have stones in them,
+// and returns P1's reward: 1 for a win, 0 for a loss and a half for a tie
+float MonteCarloTree::simulate(State& state)
+{
+	const auto numHoles = state.getConfig().numHoles;
+	uint8_t choices[MAX_HOLES];
+	for (auto moves = 0; moves < MAX_PLAYOUT_MOVES && !state.isEndState();
+			++moves)
+	{
+		const auto holes = state.getIsP1Turn() ? state.p1Holes()
+				: state.p2Holes();
+		auto count = 0u;
+		for (auto hole = 0; hole < numHoles; ++hole)
+		{
+			if (holes[hole] != 0)
+			{
+				choices[count++] = hole + 1;
+			}
+		}
+		const auto pick = random.below(2 * count);
+		applyMove(state, Move(choices[pick / 2], pick % 2 == 1));
+	}
+
+	if (state.p1Captures() != state.p2Captures())
+	{
+		return state.p1Captures() > state.p2Captures() ? 1.0f : 0.0f;
+	}
+	return 0.5f;
+}
+
+}
+
+/**
+ * Monte Carlo tree search, parallel at the root: each thread of the
+ * context's pool grows a tree of its own, and the trees' playouts are
+ * added up move by move at the end. The trees share nothing, so the
+ * threads never wait on each other.
+ *
+ * Each thread's random playouts are seeded from the position, so with a
+ * playout budget the result is the same every time.
+ */
+MonteCarloResult searchMonteCarlo(SearchContext& context, const State& state,
+		int playouts)
+{
+	assert(!state.isEndState() && (playouts > 0 || context.hasDeadline));
+	// Every tree gets at least one playout, so its root has children
+	auto threads = context.threadPool ? context.threadPool->size() : 1;
+	if (playouts > 0)
+	{
+		threads = std::min(threads, playouts);
+	}
+	auto capacity = MAX_TREE_NODES;
+	if (playouts > 0)
+	{
+		// Every playout expands at most one node
+		capacity = std::min(capacity, static_cast<std::size_t>(
+				playouts / threads + 1) * 2 * state.getConfig().numHoles + 1);
+	}
+
+	auto trees = std::vector<std::unique_ptr<MonteCarloTree> >(threads);
+	std::atomic<int> totalPlayouts{0};
+	const auto job = [&](int thread)
+	{
+		if (thread >= threads)
+		{
+			return;
+		}
+		trees[thread] = std::make_unique<MonteCarloTree>(state, capacity,
+				state.getHash() + thread * 0x9e3779b97f4a7c15ULL);
+		auto& tree = *trees[thread];
+		const auto quota = playouts == 0 ? std::numeric_limits<int>::max()
+				: playouts / threads + (thread < playouts % threads);
+		auto done = 0;
+		for (; done < quota; ++done)
+		{
+			if ((done & PLAYOUT_CLOCK_MASK) == PLAYOUT_CLOCK_MASK
+					&& checkSearchClock(context))
+			{
+				break;
+			}
+			tree.playout();
+		}
+		totalPlayouts += done;
+	};
+	if (context.threadPool)
+	{
+		context.threadPool->runOnAll(job);
+	}
+	else
+	{
+		job(0);
+	}
+
+	auto result = MonteCarloResult{};
+	result.playouts = totalPlayouts;
+	for (const auto& tree : trees)
+	{
+		result.treeNodes += tree->getNodes().size();
+	}
+
+	// Follow the most played sowings for as long as they are the mover's
+	// and have had enough playouts to go on. Every tree that expanded a
+	// node orders its children the same way, and ties go to the first.
+	auto cursors = std::vector<int32_t>(threads, 0);
+	auto current = state;
+	do
+	{
+		uint32_t visits[2 * MAX_HOLES + 2] = {};
+		float wins[2 * MAX_HOLES + 2] = {};
+		auto order = std::vector<uint8_t>{};
+		for (auto t = 0; t < threads; ++t)
+		{
+			const auto& nodes = trees[t]->getNodes();
+			if (cursors[t] == NO_CHILDREN)
+			{
+				continue;
+			}
+			const auto& node = nodes[cursors[t]];
+			const auto firstExpanded = order.empty();
+			for (auto i = node.firstChild;
+					i < node.firstChild + node.numChildren; ++i)
+			{
+				visits[nodes[i].move] += nodes[i].visits;
+				wins[nodes[i].move] += nodes[i].wins;
+				if (firstExpanded)
+				{
+					order.push_back(nodes[i].move);
+				}
+			}
+		}
+		if (order.empty())
+		{
+			assert(!result.moves.empty());
+			break;
+		}
+		auto best = order.front();
+		for (auto code : order)
+		{
+			best = visits[code] > visits[best] ? code : best;
+		}
+		if (visits[best] < MIN_TRUSTED_VISITS && !result.moves.empty())
+		{
+			break;
+		}
+		assert(visits[best] > 0);
+		if (result.moves.empty())
+		{
+			result.winRate = wins[best] / visits[best];
+		}
+
+		result.moves.push(decodeMove(best));
+		applyMove(current, decodeMove(best));
+		for (auto t = 0; t < threads; ++t)
+		{
+			const auto& nodes = trees[t]->getNodes();
+			auto next = NO_CHILDREN;
+			if (cursors[t] != NO_CHILDREN)
+			{
+				const auto& node = nodes[cursors[t]];
+				for (auto i = node.firstChild;
+						i < node.firstChild + node.numChildren; ++i)
+				{
+					next = nodes[i].move == best ? i : next;
+				}
+			}
+			cursors[t] = next;
+		}
+	} while (!current.isEndState()
+			&& current.getIsP1Turn() == state.getIsP1Turn());
+
+	// A bonus move that ends the game still leaves the mover to pass, the
+	// way MoveIterator finishes such turns
+	if (current.isEndState() && current.getIsP1Turn() == state.getIsP1Turn())
+	{
+		result.moves.push(Move(1, false));
+	}
+	return result;
+}
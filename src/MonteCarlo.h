@@ -0,0 +1,32 @@
+/*
+ * MonteCarlo.h
+ *
+ *  Created on: Mar 21, 2016
+ *      Author: derek
+ */
+
+#ifndef SRC_MONTECARLO_H_
+#define SRC_MONTECARLO_H_
+
+#include "Move.h"
+#include "State.h"
+struct SearchContext;
+
+struct MonteCarloResult
+{
+	// The start of the best turn found. If it doesn't end the turn, the
+	// tree didn't see far enough into the bonus moves, and the rest of the
+	// turn needs a search of its own.
+	MoveSequence moves;
+	int playouts;
+	int treeNodes;
+	// Share of moves.front()'s playouts that the player to move won, with
+	// ties counting half
+	double winRate;
+};
+
+// Without a playout budget (0), plays out until the context's deadline
+MonteCarloResult searchMonteCarlo(SearchContext& context, const State& state,
+		int playouts);
+
+#endif /* SRC_MONTECARLO_H_ */
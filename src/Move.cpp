@@ -7,8 +7,9 @@
 
 #include "Move.h"
 #include "State.h"
-#include "HoleIterator.h"
 #include "Settings.h"
+#include "Sowing.h"
+#include "Zobrist.h"
 #include <ostream>
 #include <iomanip>
 #include <iostream>
@@ -33,38 +34,54 @@ std::ostream& operator<<(std::ostream& stream, const Move& move)
 
 void applyMove(State& state, const Move& move)
 {
-	assert(move.holeNumber > 0 && move.holeNumber <= globalState().numHoles);
+	const auto& config = state.getConfig();
+	assert(move.holeNumber > 0 && move.holeNumber <= config.numHoles);
 
 	// Take all the stones in the chosen hole and drop them in successive
-	// holes one by one.
-	auto iter = HoleIterator{move, state};
-	auto stonesInHand = *iter;
-	*iter = 0;
-	while (stonesInHand > 0)
+	// holes one by one, following the precomputed path for this move.
+	// Whole laps of the board are dropped all at once.
+	const auto& table = config.sowing;
+	const auto player = static_cast<int>(!state.getIsP1Turn());
+	const auto hole = move.holeNumber - 1;
+	const auto* path = table.path[player][move.clockwise][hole];
+	auto stonesInHand = state.board[path[0]];
+	state.board[path[0]] = 0;
+	state.hash -= ZOBRIST.square[path[0]] * stonesInHand;
+	const auto laps = static_cast<uint8_t>(stonesInHand / table.lapLength);
+	if (laps > 0)
 	{
-		iter.next();
-		*iter += 1;
-		stonesInHand -= 1;
+		sowLaps(state.board, table.lapStones[player], laps);
+		state.hash += table.lapHash[player] * laps;
 	}
+	for (auto k = 1; k <= stonesInHand % table.lapLength; ++k)
+	{
+		state.board[path[k]] += 1;
+		state.hash += ZOBRIST.square[path[k]];
+	}
+	const auto last = path[stonesInHand];
+	state.holeStones[player] +=
+			table.ownHoles[player][move.clockwise][hole][stonesInHand]
+			- stonesInHand;
+	state.holeStones[!player] +=
+			table.opponentHoles[player][move.clockwise][hole][stonesInHand];
 
 	// If the final stone ends up in an empty hole of yours, you get to
 	// add all the stones in your opponent's corresponding hole into
 	// your own mancala.
-	if (*iter == 1 && iter.isOwnHole())
+	const auto opposite = table.captureFrom[player][last];
+	if (state.board[last] == 1 && opposite != NO_CAPTURE)
 	{
-		if (state.getIsP1Turn())
-		{
-			state.p1Captures += iter.opposite();
-		}
-		else
-		{
-			state.p2Captures += iter.opposite();
-		}
-		iter.opposite() = 0;
+		const auto captured = state.board[opposite];
+		state.board[table.mancala[player]] += captured;
+		state.board[opposite] = 0;
+		state.holeStones[!player] -= captured;
+		state.hash += (ZOBRIST.square[table.mancala[player]]
+				- ZOBRIST.square[opposite]) * captured;
 	}
 
 	// If the final stone ends up in your mancala, you get another turn.
-	if (!iter.isOwnMancala())
+	// The opponent's mancala is never on the path, so any mancala is yours.
+	if (last != P1_MANCALA && last != P2_MANCALA)
 	{
 		state.nextTurn();
 	}
@@ -74,44 +91,37 @@ void applyMove(State& state, const Move& move)
 	if (state.isEndState())
 	{
 		// See if it's P1 or P2 who has no more stones
-		bool p1Done = true; // Assume it's P1 to start
-		for (auto val : state.p1Holes)
-		{
-			if (val != 0)
-			{
-				// P1 still has stones, so P2 is the one who finished
-				p1Done = false;
-				break;
-			}
-		}
+		bool p1Done = state.holeStones[0] == 0;
 
 		// Let the other player capture all remaining pieces
 		if (p1Done)
 		{
-			for (auto& val : state.p2Holes)
+			for (auto i = 0; i < config.numHoles; ++i)
 			{
-				state.p2Captures += val;
-				val = 0;
+				state.p2Holes()[i] = 0;
 			}
+			state.p2Captures() += state.holeStones[1];
+			state.rehash();
 		}
 		else
 		{
-			for (auto& val : state.p1Holes)
+			for (auto i = 0; i < config.numHoles; ++i)
 			{
-				state.p1Captures += val;
-				val = 0;
+				state.p1Holes()[i] = 0;
 			}
+			state.p1Captures() += state.holeStones[0];
+			state.rehash();
 		}
 	}
 }
 
-void applyAndPrintMoves(State& state, std::queue<Move> moves)
+void applyAndPrintMoves(State& state, const MoveSequence& moves)
 {
-	while (!moves.empty())
+	for (auto i = 0; i < moves.size(); ++i)
 	{
-		applyMove(state, moves.front());
-		std::cout << moves.front();
-		if (moves.front().clockwise)
+		applyMove(state, moves[i]);
+		std::cout << moves[i];
+		if (moves[i].clockwise)
 		{
 			std::cout << "  -> ";
 		}
@@ -124,24 +134,21 @@ void applyAndPrintMoves(State& state, std::queue<Move> moves)
 			std::cout << " ";
 		}
 		std::cout << state << std::endl;
-		moves.pop();
 	}
 }
 
-void applyMoves(State& state, std::queue<Move> moves)
+void applyMoves(State& state, const MoveSequence& moves)
 {
-	while (!moves.empty())
+	for (auto i = 0; i < moves.size(); ++i)
 	{
-		applyMove(state, moves.front());
-		moves.pop();
+		applyMove(state, moves[i]);
 	}
 }
 
-void printMoves(std::queue<Move> moves)
+void printMoves(const MoveSequence& moves)
 {
-	while (!moves.empty())
+	for (auto i = 0; i < moves.size(); ++i)
 	{
-		std::cout << moves.front() << ",";
-		moves.pop();
+		std::cout << moves[i] << ",";
 	}
 }
@@ -8,10 +8,9 @@
 #ifndef SRC_MOVE_H_
 #define SRC_MOVE_H_
 
+#include "State.h"
 #include <cstdint>
 #include <iosfwd>
-#include <queue>
-class State;
 
 struct Move
 {
@@ -22,10 +21,45 @@ public:
 	std::ostream& print(std::ostream& stream) const;
 };
 
+// Every bonus move drops at least one stone in a mancala, so a turn can't
+// have more moves than there are stones, plus the one that ends it.
+constexpr uint8_t MAX_TURN_LENGTH = MAX_TOTAL_STONES + 1;
+
+// Packs a single Move into one byte. Zero means no move.
+inline uint8_t encodeMove(const Move& move)
+{
+	return static_cast<uint8_t>(move.holeNumber << 1 | move.clockwise);
+}
+
+inline Move decodeMove(uint8_t code)
+{
+	return Move(code >> 1, code & 1);
+}
+
+/**
+ * The moves that make up one turn: the first move, followed by any bonus
+ * moves it earned. Moves are stored inline as encodeMove() bytes, so
+ * copying a sequence is a memcpy and never touches the heap.
+ */
+class MoveSequence
+{
+public:
+	MoveSequence() : length{0}, moves{} {}
+	bool empty() const { return length == 0; }
+	uint8_t size() const { return length; }
+	Move operator[](uint8_t i) const { return decodeMove(moves[i]); }
+	Move front() const { return decodeMove(moves[0]); }
+	void push(const Move& move) { moves[length++] = encodeMove(move); }
+	void clear() { length = 0; }
+private:
+	uint8_t length;
+	uint8_t moves[MAX_TURN_LENGTH];
+};
+
 void applyMove(State& state, const Move& move);
-void applyMoves(State& state, std::queue<Move> moves);
-void applyAndPrintMoves(State& state, std::queue<Move> moves);
+void applyMoves(State& state, const MoveSequence& moves);
+void applyAndPrintMoves(State& state, const MoveSequence& moves);
 std::ostream& operator<<(std::ostream& stream, const Move& move);
-void printMoves(std::queue<Move> moves);
+void printMoves(const MoveSequence& moves);
 
 #endif /* SRC_MOVE_H_ */
@@ -9,96 +9,172 @@
 #include "Move.h"
 #include "Settings.h"
 #include "State.h"
-#include <queue>
 #include <cassert>
 
+namespace
+{
+
+// Steps move through the default order: hole 1 ccw, hole 1 cw, hole 2 ccw,
+// and so on. Returns false once it has gone past the last hole.
+bool nextInDefaultOrder(Move& move, int numHoles)
+{
+	if (!move.clockwise)
+	{
+		// If counterclockwise, increment by making it clockwise
+		move.clockwise = true;
+		return true;
+	}
+
+	// If clockwise, increment by making it counterclockwise and
+	// incrementing the move number
+	move.clockwise = false;
+	move.holeNumber += 1;
+	return move.holeNumber <= numHoles;
+}
+
+}
+
 MoveIterator::MoveIterator(const State& state)
 : state{state},
   move{1, false},
-  bonusMove{nullptr}
+  order{},
+  position{0},
+  bonusMoves{},
+  result{state},
+  turnReady{false}
 {
 }
 
+// Starts over on newState's moves, in the default order. The bonus move
+// stack keeps its memory, so reused iterators don't allocate.
+void MoveIterator::reset(const State& newState)
+{
+	state = newState;
+	move = Move(1, false);
+	order.size = 0;
+	position = 0;
+	bonusMoves.clear();
+	turnReady = false;
+}
+
+// Replaces the default order (hole 1 ccw, hole 1 cw, hole 2 ccw, ...) for
+// the first move of the turn. Bonus moves still use the default order.
+// Must be called before the iterator is used.
+void MoveIterator::setOrder(const MoveOrder& newOrder)
+{
+	assert(newOrder.size > 0 && !turnReady && position == 0);
+	order = newOrder;
+	move = decodeMove(order.moves[0]);
+}
+
 bool MoveIterator::isValid() const
 {
-	return move.holeNumber <= globalState().numHoles
+	return move.holeNumber <= state.getConfig().numHoles
 			&& move.holeNumber >= 1;
 }
 
 void MoveIterator::next()
 {
-	// If we're on a bonus move, defer to the bonus move iterator
-	if (bonusMove)
+	assert(isValid());
+	if (!turnReady)
 	{
-		bonusMove->next();
-		if (bonusMove->isValid())
+		startTurn();
+	}
+
+	// The next turn differs from this one in its last bonus move that
+	// has a move after it, so only the sowings from there on are redone
+	const auto numHoles = state.getConfig().numHoles;
+	while (!bonusMoves.empty())
+	{
+		auto& last = bonusMoves.back();
+		if (nextInDefaultOrder(last.move, numHoles))
 		{
+			result = last.before;
+			applyMove(result, last.move);
+			finishTurn();
 			return;
 		}
-		else
-		{
-			// The bonus move didn't have anything more to iterate over,
-			// so "next move" means we're done with the bonus move
-			// and we increment normally.
-			bonusMove = nullptr;
-		}
+		bonusMoves.pop_back();
 	}
 
-	if (!move.clockwise)
+	turnReady = false;
+	if (order.size > 0)
 	{
-		// If counterclockwise, increment by making it clockwise
-		move.clockwise = true;
+		position += 1;
+		move = position < order.size
+				? decodeMove(order.moves[position]) : NO_MORE_MOVES();
 	}
-	else
+	else if (!nextInDefaultOrder(move, numHoles))
 	{
-		// If clockwise, increment by making it counterclockwise
-		// and incrementing the move number
-		move.clockwise = false;
-		move.holeNumber += 1;
-
-		// If we've run out of holes, invalidate the iterator
-		if (move.holeNumber > globalState().numHoles)
-		{
-			move = NO_MORE_MOVES();
-		}
+		// We've run out of holes, so invalidate the iterator
+		move = NO_MORE_MOVES();
 	}
 }
 
-std::queue<Move> MoveIterator::operator*()
+MoveSequence MoveIterator::operator*()
 {
 	assert(isValid());
+	if (!turnReady)
+	{
+		startTurn();
+	}
 
-	// Add the current move to what we're returning
-	auto ret = std::queue<Move>{};
+	auto ret = MoveSequence{};
 	ret.push(move);
+	for (const auto& bonus : bonusMoves)
+	{
+		ret.push(bonus.move);
+	}
+	return ret;
+}
 
-	// Even if we're not in the middle of iterating through a bonus move,
-	// still check to see if we should be, before returning anything.
-	if (!bonusMove)
+// The position the current turn leads to
+const State& MoveIterator::resultingState()
+{
+	assert(isValid());
+	if (!turnReady)
 	{
-		auto projectedState = state;
-		applyMove(projectedState, move);
-		if (projectedState.getIsP1Turn() == state.getIsP1Turn())
-		{
-			bonusMove = std::make_unique<MoveIterator>(projectedState);
-		}
+		startTurn();
 	}
+	return result;
+}
 
-	// If we've either just started a bonus move, or are in the
-	// middle of iterating through one, we need to add those to what we return
-	if (bonusMove)
+// Whether the current turn ends by sowing from an empty hole, which does
+// nothing but pass. Passing always ends the turn, so no earlier move can.
+bool MoveIterator::turnPasses()
+{
+	assert(isValid());
+	if (!turnReady)
 	{
-		// We are already iterating through
-		assert(bonusMove->isValid());
-		auto bms = bonusMove->operator*();
-		while (!bms.empty())
-		{
-			ret.push(bms.front());
-			bms.pop();
-		}
+		startTurn();
 	}
+	const auto& before = bonusMoves.empty() ? state : bonusMoves.back().before;
+	const auto last = bonusMoves.empty() ? move : bonusMoves.back().move;
+	const auto holes = before.getIsP1Turn() ? before.p1Holes()
+			: before.p2Holes();
+	return holes[last.holeNumber - 1] == 0;
+}
 
-	return ret;
+// Makes the first move of the current turn, and the first chain of bonus
+// moves after it
+void MoveIterator::startTurn()
+{
+	result = state;
+	applyMove(result, move);
+	bonusMoves.clear();
+	finishTurn();
+	turnReady = true;
+}
+
+// Extends the turn, which so far leads to result, with the first bonus
+// move in the default order until it is the other player's turn
+void MoveIterator::finishTurn()
+{
+	while (result.getIsP1Turn() == state.getIsP1Turn())
+	{
+		bonusMoves.push_back(BonusMove{result, Move(1, false)});
+		applyMove(result, bonusMoves.back().move);
+	}
 }
 
 const Move& NO_MORE_MOVES()
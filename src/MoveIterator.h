@@ -10,22 +10,54 @@
 
 #include "Move.h"
 #include "State.h"
-#include <memory>
-#include <queue>
+#include <vector>
 
 const Move& NO_MORE_MOVES();
 
+// The order in which a MoveIterator tries a turn's first move
+struct MoveOrder
+{
+	uint8_t size;
+	uint8_t moves[2 * MAX_HOLES]; // encodeMove() codes, first to last
+};
+
+/**
+ * Goes through every turn a player can take from a position: each first
+ * move, followed by every chain of bonus moves it earns.
+ *
+ * The bonus moves of the current turn are kept on a stack along with the
+ * positions they were made from, so moving on to the next turn only
+ * replays the sowings that changed, and the position the turn leads to is
+ * already there for the caller.
+ */
 class MoveIterator
 {
 public:
 	explicit MoveIterator(const State& state);
+	void reset(const State& newState);
+	void setOrder(const MoveOrder& newOrder);
 	bool isValid() const;
 	void next();
-	std::queue<Move> operator*();
+	MoveSequence operator*();
+	const State& resultingState();
+	bool turnPasses();
 private:
+	// A bonus move of the current turn, and the position it is made from
+	struct BonusMove
+	{
+		State before;
+		Move move;
+	};
 	State state;
-	Move move;
-	std::unique_ptr<MoveIterator> bonusMove;
+	Move move;                         // the current turn's first move
+	MoveOrder order; // unused (size 0) for the default order
+	uint8_t position;
+	std::vector<BonusMove> bonusMoves; // the rest of the turn, in order
+	State result;                      // the position after the whole turn
+	bool turnReady;                    // whether bonusMoves and result are
+	                                   // worked out for move yet
+	void startTurn();
+	void finishTurn();
 };
 
 #endif /* SRC_MOVEITERATOR_H_ */
@@ -0,0 +1,122 @@
+/*
+ * MoveOrdering.cpp
+ *
+ *  Created on: Mar 14, 2016
+ *      Author: derek
+ */
+
+#include "MoveOrdering.h"
+#include "Move.h"
+#include "MoveIterator.h"
+#include "Settings.h"
+#include "State.h"
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+
+void fillNaturalOrder(const State& state, MoveOrder& order)
+{
+	order.size = 0;
+	for (auto hole = 1; hole <= state.getConfig().numHoles; ++hole)
+	{
+		order.moves[order.size++] = encodeMove(Move(hole, false));
+		order.moves[order.size++] = encodeMove(Move(hole, true));
+	}
+}
+
+}
+
+void NaturalOrderer::orderMoves(const State& state, uint8_t, uint8_t,
+		MoveOrder& order)
+{
+	fillNaturalOrder(state, order);
+}
+
+void NaturalOrderer::cutoff(const State&, uint8_t, uint8_t, const Move&)
+{
+}
+
+void NaturalOrderer::clear()
+{
+}
+
+KillerHistoryOrderer::KillerHistoryOrderer()
+{
+	clear();
+}
+
+void KillerHistoryOrderer::orderMoves(const State& state, uint8_t ply,
+		uint8_t hint, MoveOrder& order)
+{
+	fillNaturalOrder(state, order);
+
+	// Score every move, then insertion sort from best to worst. Ties keep
+	// the natural order.
+	const auto player = static_cast<int>(!state.getIsP1Turn());
+	int scores[2 * MAX_HOLES];
+	for (auto i = 0; i < order.size; ++i)
+	{
+		const auto code = order.moves[i];
+		const auto move = decodeMove(code);
+		if (code == hint)
+		{
+			scores[i] = 1 << 30;
+		}
+		else if (code == killers[ply][0])
+		{
+			scores[i] = 1 << 29;
+		}
+		else if (code == killers[ply][1])
+		{
+			scores[i] = 1 << 28;
+		}
+		else
+		{
+			scores[i] = history[player][move.holeNumber-1][move.clockwise];
+		}
+
+		for (auto j = i; j > 0 && scores[j] > scores[j-1]; --j)
+		{
+			std::swap(scores[j], scores[j-1]);
+			std::swap(order.moves[j], order.moves[j-1]);
+		}
+	}
+}
+
+void KillerHistoryOrderer::cutoff(const State& state, uint8_t ply,
+		uint8_t depth, const Move& move)
+{
+	const auto code = encodeMove(move);
+	if (killers[ply][0] != code)
+	{
+		killers[ply][1] = killers[ply][0];
+		killers[ply][0] = code;
+	}
+
+	// Cutoffs near the root save far more work, so they count for more.
+	// Scores are halved now and then to stay below the killer scores.
+	const auto player = static_cast<int>(!state.getIsP1Turn());
+	auto& score = history[player][move.holeNumber-1][move.clockwise];
+	score += depth * depth;
+	if (score > 1 << 27)
+	{
+		for (auto& holes : history)
+		{
+			for (auto& directions : holes)
+			{
+				for (auto& h : directions)
+				{
+					h /= 2;
+				}
+			}
+		}
+	}
+}
+
+void KillerHistoryOrderer::clear()
+{
+	std::memset(killers, 0, sizeof(killers));
+	std::memset(history, 0, sizeof(history));
+}
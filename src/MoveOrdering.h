@@ -0,0 +1,74 @@
+/*
+ * MoveOrdering.h
+ *
+ *  Created on: Mar 14, 2016
+ *      Author: derek
+ */
+
+#ifndef SRC_MOVEORDERING_H_
+#define SRC_MOVEORDERING_H_
+
+#include "Move.h"
+#include "MoveIterator.h"
+#include "Settings.h"
+#include "State.h"
+#include <cstdint>
+
+/**
+ * Decides the order a node tries its moves in. Alpha-beta prunes the most
+ * when the best move comes first, so a good orderer makes the search
+ * cheaper without changing the values it finds.
+ *
+ * Each search thread has its own orderer (see SearchThread), which
+ * learns from the cutoffs seen by all iterations of the current search.
+ */
+class MoveOrderer
+{
+public:
+	virtual ~MoveOrderer() = default;
+
+	// Fills in order for a node at the given distance from the root.
+	// hint is the encodeMove() code of the best move found for this
+	// position by an earlier iteration, or 0 if there is none.
+	virtual void orderMoves(const State& state, uint8_t ply, uint8_t hint,
+			MoveOrder& order) = 0;
+
+	// Called when move caused a cutoff at a node depth turns from the
+	// search horizon.
+	virtual void cutoff(const State& state, uint8_t ply, uint8_t depth,
+			const Move& move) = 0;
+
+	// Forgets everything learned, ready for a new root position
+	virtual void clear() = 0;
+};
+
+// hole 1 ccw, hole 1 cw, hole 2 ccw, ..., which is what MoveIterator does
+// when it isn't given an order.
+class NaturalOrderer : public MoveOrderer
+{
+public:
+	void orderMoves(const State& state, uint8_t ply, uint8_t hint,
+			MoveOrder& order) override;
+	void cutoff(const State& state, uint8_t ply, uint8_t depth,
+			const Move& move) override;
+	void clear() override;
+};
+
+// The previous iteration's best move first, then the two most recent
+// killer moves for this ply, then the rest by how often they have caused
+// cutoffs anywhere in the tree (the history heuristic).
+class KillerHistoryOrderer : public MoveOrderer
+{
+public:
+	KillerHistoryOrderer();
+	void orderMoves(const State& state, uint8_t ply, uint8_t hint,
+			MoveOrder& order) override;
+	void cutoff(const State& state, uint8_t ply, uint8_t depth,
+			const Move& move) override;
+	void clear() override;
+private:
+	uint8_t killers[MAX_SEARCH_DEPTH + 1][2];
+	int history[2][MAX_HOLES][2]; // [player][hole-1][clockwise]
+};
+
+#endif /* SRC_MOVEORDERING_H_ */
@@ -0,0 +1,542 @@
+/*
+ * Negamax.cpp
+ *
+ *  Created on: Mar 21, 2016
+ *      Author: derek
+ */
+
+/**
+ * Searches in negamax form: every position is scored for the player to
+ * move, and a child's score is the negation of its own. There are two
+ * drivers for the one search() below.
+ *
+ * Principal variation search: only the first child of a node, which move
+ * ordering makes the likely best, is searched with the node's full window.
+ * The rest are searched with a null window just above alpha, which is
+ * enough to prove them no better; the few that turn out better are
+ * searched again in full.
+ *
+ * The root is searched with an aspiration window around the previous
+ * iteration's value, widened and searched again if the value falls
+ * outside it.
+ *
+ * MTD(f): the root is searched with nothing but zero windows, each of
+ * which only tells whether the value is above or below a guess. The
+ * guesses close in on the value from both sides until it is pinned down.
+ * With null windows throughout, search() is plain alpha-beta, and the
+ * transposition table is the memory that keeps the repeated passes cheap,
+ * so MTD(f) needs the table to be any good.
+ *
+ * Like the Node search, leaves are scored for the root player, values in
+ * the transposition table are stored from the root player's side, and only
+ * table entries of exactly the right depth are trusted. At the root of a
+ * principal variation search, moves that tie for best are still told apart
+ * the way Node::tiebreaker() does. MTD(f) never learns which moves tie, so
+ * it only tries no-ops last. Both always prune and run on the calling
+ * thread only.
+ */
+#include "Negamax.h"
+#include "Move.h"
+#include "MoveIterator.h"
+#include "MoveOrdering.h"
+#include "SearchThread.h"
+#include "Settings.h"
+#include <algorithm>
+#include <cassert>
+
+namespace
+{
+
+const int INFINITE = 99999999;
+
+// Aspiration windows start this many captured stones either side of the
+// guess, and grow fourfold each time the value falls outside
+const int ASPIRATION_STONES = 2;
+
+// Past this, the window is simply opened all the way
+const int MAX_ASPIRATION = 1 << 16;
+
+template <typename Evaluator>
+class NegamaxSearch
+{
+public:
+	NegamaxSearch(SearchContext& context, const State& root);
+	SearchResult runPrincipalVariation(uint8_t depth, int guess);
+	SearchResult runMtdf(uint8_t depth, int guess);
+private:
+	SearchContext& context;
+	SearchStats& stats; // these two are in the calling thread's SearchThread
+	MoveOrderer& orderer;
+	const State& root;
+	bool p1IsMaximizer;
+	int nodesExpanded;
+	int passes;
+	SearchResult searchRoot(uint8_t depth, int alpha, int beta);
+	int probeRoot(uint8_t depth, int beta, MoveSequence& cutMove);
+	int search(const State& state, uint8_t depth, uint8_t ply,
+			int alpha, int beta);
+	int evaluateLeaf(const State& state, uint8_t ply) const;
+	bool tableCutoff(const State& state, uint8_t depth, uint8_t ply,
+			int& alpha, int& beta, int& value, uint8_t& hint) const;
+	void store(const State& state, uint8_t depth, uint8_t ply, int value,
+			int alpha, int beta, uint8_t bestMove) const;
+	bool clockExpired();
+};
+
+// Whether the player to move at ply is the root player
+bool rootToMove(uint8_t ply)
+{
+	return ply % 2 == 0;
+}
+
+template <typename Evaluator>
+NegamaxSearch<Evaluator>::NegamaxSearch(
+		SearchContext& context, const State& root)
+: context{context},
+  stats{context.threads[0]->stats},
+  orderer{context.threads[0]->orderer(context)},
+  root{root},
+  p1IsMaximizer{root.getIsP1Turn()},
+  nodesExpanded{0},
+  passes{0}
+{
+}
+
+template <typename Evaluator>
+SearchResult NegamaxSearch<Evaluator>::runPrincipalVariation(
+		uint8_t depth, int guess)
+{
+	stats = SearchStats{};
+	if (guess == NO_GUESS)
+	{
+		passes += 1;
+		return searchRoot(depth, -INFINITE, INFINITE);
+	}
+
+	auto delta = ASPIRATION_STONES * Evaluator::stoneValue();
+	while (true)
+	{
+		passes += 1;
+		const auto alpha = delta < MAX_ASPIRATION ? guess - delta : -INFINITE;
+		const auto beta = delta < MAX_ASPIRATION ? guess + delta : INFINITE;
+		auto result = searchRoot(depth, alpha, beta);
+		if (!result.complete
+				|| (result.value > alpha && result.value < beta)
+				|| (alpha == -INFINITE && beta == INFINITE))
+		{
+			return result;
+		}
+		delta *= 4;
+	}
+}
+
+/**
+ * Zero-window passes until the value is known exactly. Each pass that
+ * fails high proves the value is at least its result, and the move that
+ * proved it is the best move found so far; the last such pass proves the
+ * value itself.
+ */
+template <typename Evaluator>
+SearchResult NegamaxSearch<Evaluator>::runMtdf(uint8_t depth, int guess)
+{
+	stats = SearchStats{};
+	auto value = guess != NO_GUESS ? guess
+			: Evaluator::evaluate(root, p1IsMaximizer);
+	auto lower = -INFINITE;
+	auto upper = INFINITE;
+	auto bestMove = MoveSequence{};
+	while (lower < upper)
+	{
+		const auto beta = value == lower ? value + 1 : value;
+		auto cutMove = MoveSequence{};
+		value = probeRoot(depth, beta, cutMove);
+		if (searchStopped(context))
+		{
+			return SearchResult{bestMove, lower, nodesExpanded,
+					stats, false, passes};
+		}
+		if (value < beta)
+		{
+			upper = value;
+		}
+		else
+		{
+			lower = value;
+			bestMove = cutMove;
+		}
+	}
+	return SearchResult{bestMove, value, nodesExpanded,
+			stats, true, passes};
+}
+
+// One MTD(f) pass: searches the root with window (beta - 1, beta), and
+// returns at least beta, with the move that got there in cutMove, or less
+// than beta if no move does. No-ops are tried last, so a real move that is
+// just as good wins.
+template <typename Evaluator>
+int NegamaxSearch<Evaluator>::probeRoot(uint8_t depth, int beta,
+		MoveSequence& cutMove)
+{
+	passes += 1;
+	auto hint = uint8_t{0};
+	auto entry = TableEntry{};
+	auto table = context.transpositionTable;
+	if (table && table->probe(root.getHash(), entry))
+	{
+		hint = entry.bestMove;
+	}
+	auto order = MoveOrder{};
+	orderer.orderMoves(root, 0, hint, order);
+	const auto holes = root.getIsP1Turn() ? root.p1Holes() : root.p2Holes();
+	std::stable_partition(order.moves, order.moves + order.size,
+			[&](uint8_t code)
+			{
+				return holes[decodeMove(code).holeNumber-1] != 0;
+			});
+
+	auto best = -INFINITE;
+	auto bestCode = uint8_t{0};
+	auto movesTried = 0;
+	auto iter = MoveIterator{root};
+	iter.setOrder(order);
+	for (; iter.isValid(); iter.next())
+	{
+		nodesExpanded += 1;
+		movesTried += 1;
+		const auto& child = iter.resultingState();
+		auto turn = *iter;
+		stats.countTurn(1, turn.size());
+		const auto score = -search(child, depth - 1, 1, -beta, -(beta - 1));
+		if (searchStopped(context))
+		{
+			return best;
+		}
+		if (score > best)
+		{
+			best = score;
+			bestCode = encodeMove(turn.front());
+		}
+		if (best >= beta)
+		{
+			cutMove = turn;
+			orderer.cutoff(root, 0, depth, turn.front());
+			stats.countCutoff(movesTried);
+			break;
+		}
+	}
+	if (bestCode != 0)
+	{
+		store(root, depth, 0, best, beta - 1, beta, bestCode);
+	}
+	return best;
+}
+
+/**
+ * Searches the root's moves with window (alpha, beta). A value at or
+ * outside the window is only a bound, and its move is not to be trusted.
+ *
+ * Later moves are scouted with their window lowered by one, so a move that
+ * ties the best so far gets an exact value and can be tiebroken.
+ */
+template <typename Evaluator>
+SearchResult NegamaxSearch<Evaluator>::searchRoot(uint8_t depth,
+		int alpha, int beta)
+{
+	auto hint = uint8_t{0};
+	auto entry = TableEntry{};
+	auto table = context.transpositionTable;
+	if (table && table->probe(root.getHash(), entry))
+	{
+		hint = entry.bestMove;
+	}
+	auto order = MoveOrder{};
+	orderer.orderMoves(root, 0, hint, order);
+
+	const auto originalAlpha = alpha;
+	auto best = -INFINITE;
+	auto bestMove = MoveSequence{};
+	auto bestStatic = 0;
+	auto bestPasses = false;
+	auto movesTried = 0;
+	auto iter = MoveIterator{root};
+	iter.setOrder(order);
+	for (; iter.isValid(); iter.next())
+	{
+		nodesExpanded += 1;
+		movesTried += 1;
+		const auto& child = iter.resultingState();
+		auto turn = *iter;
+		stats.countTurn(1, turn.size());
+		const auto turnPasses = iter.turnPasses();
+
+		auto score = 0;
+		if (bestMove.empty())
+		{
+			score = -search(child, depth - 1, 1, -beta, -alpha);
+		}
+		else
+		{
+			score = -search(child, depth - 1, 1, -alpha, -(alpha - 1));
+			if (score >= alpha && score < beta && !searchStopped(context))
+			{
+				score = -search(child, depth - 1, 1, -beta, -(alpha - 1));
+			}
+		}
+		if (searchStopped(context))
+		{
+			break;
+		}
+
+		// Ties go to actual moves over no-ops, then to the move whose
+		// position looks better right away (see Node::tiebreaker())
+		const auto childStatic = Evaluator::evaluate(child, p1IsMaximizer);
+		if (score > best || (score == best
+				&& (bestPasses || childStatic > bestStatic)))
+		{
+			best = score;
+			bestMove = turn;
+			bestStatic = childStatic;
+			bestPasses = turnPasses;
+		}
+		if (best > alpha)
+		{
+			alpha = best;
+		}
+		if (alpha >= beta)
+		{
+			orderer.cutoff(root, 0, depth, turn.front());
+			stats.countCutoff(movesTried);
+			break;
+		}
+	}
+
+	const auto complete = !searchStopped(context);
+	if (complete && !bestMove.empty())
+	{
+		store(root, depth, 0, best, originalAlpha, beta,
+				encodeMove(bestMove.front()));
+	}
+	return SearchResult{bestMove, best, nodesExpanded,
+			stats, complete, passes};
+}
+
+/**
+ * Negamax value of state for the player to move, depth turns deep and ply
+ * turns below the root. Returns something meaningless once the search has
+ * been stopped.
+ */
+template <typename Evaluator>
+int NegamaxSearch<Evaluator>::search(const State& state,
+		uint8_t depth, uint8_t ply, int alpha, int beta)
+{
+	if (depth == 0 || state.isEndState())
+	{
+		return evaluateLeaf(state, ply);
+	}
+
+	auto value = 0;
+	auto hint = uint8_t{0};
+	if (tableCutoff(state, depth, ply, alpha, beta, value, hint))
+	{
+		return value;
+	}
+	auto order = MoveOrder{};
+	orderer.orderMoves(state, ply, hint, order);
+
+	const auto originalAlpha = alpha;
+	auto best = -INFINITE;
+	auto bestMove = uint8_t{0};
+	auto movesTried = 0;
+	auto iter = MoveIterator{state};
+	iter.setOrder(order);
+	for (; iter.isValid(); iter.next())
+	{
+		if (clockExpired())
+		{
+			return 0;
+		}
+		movesTried += 1;
+		const auto& child = iter.resultingState();
+		auto turn = *iter;
+		stats.countTurn(ply + 1, turn.size());
+
+		auto score = 0;
+		if (bestMove == 0)
+		{
+			score = -search(child, depth - 1, ply + 1, -beta, -alpha);
+		}
+		else
+		{
+			score = -search(child, depth - 1, ply + 1, -alpha - 1, -alpha);
+			if (score > alpha && score < beta && !searchStopped(context))
+			{
+				score = -search(child, depth - 1, ply + 1, -beta, -alpha);
+			}
+		}
+		if (searchStopped(context))
+		{
+			return 0;
+		}
+
+		if (score > best || bestMove == 0)
+		{
+			best = score;
+			bestMove = encodeMove(turn.front());
+		}
+		if (best > alpha)
+		{
+			alpha = best;
+		}
+		if (alpha >= beta)
+		{
+			orderer.cutoff(state, ply, depth, turn.front());
+			stats.countCutoff(movesTried);
+			break;
+		}
+	}
+
+	store(state, depth, ply, best, originalAlpha, beta, bestMove);
+	return best;
+}
+
+// The heuristic, or the tablebase's result if it has one, for the player
+// to move at ply
+template <typename Evaluator>
+int NegamaxSearch<Evaluator>::evaluateLeaf(const State& state,
+		uint8_t ply) const
+{
+	stats.leafEvaluations += 1;
+	auto tablebase = context.tablebase;
+	auto p1Lead = 0;
+	auto ends = false;
+	const auto value = tablebase && tablebase->probe(state, p1Lead, ends)
+			? Evaluator::evaluateSolved(state, p1Lead, ends, p1IsMaximizer)
+			: Evaluator::evaluate(state, p1IsMaximizer);
+	return rootToMove(ply) ? value : -value;
+}
+
+// Looks state up in the transposition table. Returns true if the entry
+// settles its value, which is then in value; otherwise it may narrow the
+// window, and hint is the best move to try first (or 0).
+template <typename Evaluator>
+bool NegamaxSearch<Evaluator>::tableCutoff(const State& state,
+		uint8_t depth, uint8_t ply, int& alpha, int& beta, int& value,
+		uint8_t& hint) const
+{
+	auto table = context.transpositionTable;
+	auto entry = TableEntry{};
+	if (!table || !table->probe(state.getHash(), entry))
+	{
+		return false;
+	}
+	hint = entry.bestMove;
+	if (entry.depth != depth)
+	{
+		return false;
+	}
+
+	// Entries are stored for the root player; flip them for the other
+	auto bound = entry.bound;
+	value = entry.value;
+	if (!rootToMove(ply))
+	{
+		value = -value;
+		bound = bound == Bound::LOWER ? Bound::UPPER
+				: bound == Bound::UPPER ? Bound::LOWER : bound;
+	}
+
+	if (bound == Bound::EXACT
+			|| (bound == Bound::LOWER && value >= beta)
+			|| (bound == Bound::UPPER && value <= alpha))
+	{
+		return true;
+	}
+	if (bound == Bound::LOWER && value > alpha)
+	{
+		alpha = value;
+	}
+	else if (bound == Bound::UPPER && value < beta)
+	{
+		beta = value;
+	}
+	return false;
+}
+
+// Remembers value, searched with window (alpha, beta), for state
+template <typename Evaluator>
+void NegamaxSearch<Evaluator>::store(const State& state,
+		uint8_t depth, uint8_t ply, int value, int alpha, int beta,
+		uint8_t bestMove) const
+{
+	auto table = context.transpositionTable;
+	if (!table)
+	{
+		return;
+	}
+
+	auto bound = Bound::EXACT;
+	if (value <= alpha)
+	{
+		bound = Bound::UPPER;
+	}
+	else if (value >= beta)
+	{
+		bound = Bound::LOWER;
+	}
+	if (!rootToMove(ply))
+	{
+		value = -value;
+		bound = bound == Bound::LOWER ? Bound::UPPER
+				: bound == Bound::UPPER ? Bound::LOWER : bound;
+	}
+	table->store(state.getHash(), value, depth, bound, bestMove);
+}
+
+// Counts an expansion, and every so often reads the clock
+template <typename Evaluator>
+bool NegamaxSearch<Evaluator>::clockExpired()
+{
+	nodesExpanded += 1;
+	return (nodesExpanded & CLOCK_CHECK_MASK) == 0
+			&& checkSearchClock(context);
+}
+
+}
+
+/**
+ * Finds the best move for the player to move in state, looking depth
+ * turns ahead, with an aspiration window around guess (or the full window
+ * for NO_GUESS).
+ */
+template <typename Evaluator>
+SearchResult searchPrincipalVariation(SearchContext& context,
+		const State& state, uint8_t depth, int guess)
+{
+	NegamaxSearch<Evaluator> search{context, state};
+	return search.runPrincipalVariation(depth, guess);
+}
+
+/**
+ * Likewise, by MTD(f), starting from guess (or the heuristic's score for
+ * state, for NO_GUESS)
+ */
+template <typename Evaluator>
+SearchResult searchMtdf(SearchContext& context, const State& state,
+		uint8_t depth, int guess)
+{
+	NegamaxSearch<Evaluator> search{context, state};
+	return search.runMtdf(depth, guess);
+}
+
+template SearchResult searchPrincipalVariation<Heuristic1Evaluator>(
+		SearchContext& context, const State& state, uint8_t depth,
+		int guess);
+template SearchResult searchPrincipalVariation<Heuristic2Evaluator>(
+		SearchContext& context, const State& state, uint8_t depth,
+		int guess);
+template SearchResult searchMtdf<Heuristic1Evaluator>(
+		SearchContext& context, const State& state, uint8_t depth,
+		int guess);
+template SearchResult searchMtdf<Heuristic2Evaluator>(
+		SearchContext& context, const State& state, uint8_t depth,
+		int guess);
@@ -0,0 +1,22 @@
+/*
+ * Negamax.h
+ *
+ *  Created on: Mar 21, 2016
+ *      Author: derek
+ */
+
+#ifndef SRC_NEGAMAX_H_
+#define SRC_NEGAMAX_H_
+
+#include "Search.h"
+#include "State.h"
+#include <cstdint>
+
+template <typename Evaluator>
+SearchResult searchPrincipalVariation(SearchContext& context,
+		const State& state, uint8_t depth, int guess);
+template <typename Evaluator>
+SearchResult searchMtdf(SearchContext& context, const State& state,
+		uint8_t depth, int guess);
+
+#endif /* SRC_NEGAMAX_H_ */
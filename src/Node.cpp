@@ -9,31 +9,106 @@
 #include "State.h"
 #include "Move.h"
 #include "MoveIterator.h"
+#include "MoveOrdering.h"
+#include "SearchThread.h"
 #include "Settings.h"
 #include <ostream>
 #include <iostream>
 #include <cassert>
 
-Node::Node(const State& state, Node* const parent,
-			std::unique_ptr<std::queue<Move> > action, uint8_t depth,
-			int alpha, int beta, bool maximizer)
-: state{state},
-  parent{parent},
-  action{std::move(action)},
-  depth{depth},
-  alpha{alpha},
-  beta{beta},
-  value{maximizer ? -99999999 : 99999999},
-  maximizer{maximizer},
+// An empty node, for a NodeStack frame to reset() before it is used
+template <typename Evaluator>
+Node<Evaluator>::Node(SearchContext& context, SearchThread& thread,
+		const State& state)
+: context{&context},
+  thread{&thread},
+  state{state},
+  parent{nullptr},
+  action{},
+  depth{0},
+  alpha{-99999999},
+  beta{99999999},
+  value{0},
+  maximizer{true},
   iter{state},
-  bestMove{nullptr}
+  bestMove{},
+  initialAlpha{-99999999},
+  initialBeta{99999999},
+  fromTable{false},
+  p1IsMaximizer{state.getIsP1Turn()},
+  ply{0},
+  movesTried{0},
+  staticValue{0},
+  evaluated{false},
+  actionPasses{false},
+  bestMoveValue{0},
+  bestMovePasses{false}
 {
 }
 
-// For a root node
-Node::Node(const State& state, uint8_t depth, bool maximizer)
-: Node(state, nullptr, nullptr, depth, -99999999, 99999999, maximizer)
+// For a root node, made by the thread that starts the search
+template <typename Evaluator>
+Node<Evaluator>::Node(SearchContext& context, const State& state,
+		uint8_t depth, bool maximizer)
+: Node(context, *context.threads[0], state)
 {
+	reset(state, nullptr, MoveSequence{}, depth, -99999999, 99999999,
+			maximizer);
+}
+
+// Makes this the node for state, as though it had just been created there.
+// NodeStack reuses its frames this way, so that expanding a node neither
+// allocates nor constructs anything.
+template <typename Evaluator>
+void Node<Evaluator>::reset(const State& state, Node* const parent,
+		const MoveSequence& action, uint8_t depth, int alpha, int beta,
+		bool maximizer)
+{
+	this->state = state;
+	this->parent = parent;
+	this->action = action;
+	this->depth = depth;
+	this->alpha = alpha;
+	this->beta = beta;
+	value = maximizer ? -99999999 : 99999999;
+	this->maximizer = maximizer;
+	iter.reset(state);
+	bestMove.clear();
+	initialAlpha = alpha;
+	initialBeta = beta;
+	fromTable = false;
+	p1IsMaximizer = parent ? parent->p1IsMaximizer : state.getIsP1Turn();
+	ply = parent ? parent->ply + 1 : 0;
+	movesTried = 0;
+	staticValue = 0;
+	evaluated = false;
+	actionPasses = false;
+	bestMoveValue = 0;
+	bestMovePasses = false;
+
+	if (parent && (depth == 0 || isTerminalState()))
+	{
+		// Leaves are scored once, here, however often they are asked.
+		// Positions the tablebase has solved are scored by how perfect play
+		// from them ends.
+		thread->stats.leafEvaluations += 1;
+		auto tablebase = context->tablebase;
+		auto p1Lead = 0;
+		auto ends = false;
+		value = tablebase && tablebase->probe(state, p1Lead, ends)
+				? Evaluator::evaluateSolved(state, p1Lead, ends, p1IsMaximizer)
+				: staticEvaluation();
+	}
+	else if (depth > 0 && !isTerminalState())
+	{
+		auto hint = probeTable();
+		if (!fromTable)
+		{
+			auto order = MoveOrder{};
+			thread->orderer(*context).orderMoves(state, ply, hint, order);
+			iter.setOrder(order);
+		}
+	}
 }
 
 // We will expand child nodes until we have explored all possible moves,
@@ -42,14 +117,17 @@ Node::Node(const State& state, uint8_t depth, bool maximizer)
 // any sane opponent will never let happen.
 //
 // We also stop expanding nodes when depth reaches 0 or when the game is over.
-bool Node::hasNextNode() const
+//
+// A node always gets to expand its first child, even if its window was
+// narrowed shut from outside (see narrowWindow), so it has a real value.
+template <typename Evaluator>
+bool Node<Evaluator>::hasNextNode() const
 {
-	if (depth > 0 && !isTerminalState() && iter.isValid())
+	if (!fromTable && depth > 0 && !isTerminalState() && iter.isValid())
 	{
-		if (globalState().prune)
+		if (context->prune)
 		{
-			globalState().prunedNodes += 1;
-			return beta > alpha;
+			return beta > alpha || bestMove.empty();
 		}
 		else
 		{
@@ -60,42 +138,189 @@ bool Node::hasNextNode() const
 	return false;
 }
 
-void Node::expandNextNode(std::stack<Node>& fringe)
+// Makes child the node for our next move, inheriting our current window.
+// The child keeps a pointer to us, so we must not move while it exists.
+template <typename Evaluator>
+void Node<Evaluator>::nextChildInto(Node& child)
 {
 	assert(iter.isValid());
-	auto newState = state;
-	auto newMove = std::make_unique<std::queue<Move> >(*iter);
-	applyMoves(newState, *newMove);
-	fringe.emplace(Node{newState, this,
-						std::move(newMove), depth > 0 ? depth - 1 : 0,
-						alpha, beta, !maximizer});
+	auto newMove = *iter;
+	movesTried += 1;
+	child.thread->stats.countTurn(ply + 1, newMove.size());
+	child.reset(iter.resultingState(), this, newMove,
+			static_cast<uint8_t>(depth > 0 ? depth - 1 : 0), alpha, beta,
+			!maximizer);
+	child.actionPasses = iter.turnPasses();
 	iter.next();
 }
 
-int Node::getValue() const
+// Likewise, for a child that is kept somewhere other than a NodeStack
+template <typename Evaluator>
+Node<Evaluator> Node<Evaluator>::nextChild()
 {
-	if (parent && ((depth == 0) || isTerminalState()))
+	auto child = Node{*context, *thread, state};
+	nextChildInto(child);
+	return child;
+}
+
+// True once the window has closed, so the remaining children are pruned
+template <typename Evaluator>
+bool Node<Evaluator>::isCutoff() const
+{
+	return context->prune && beta <= alpha;
+}
+
+// Tightens the window, for when better bounds have been found elsewhere
+// (e.g. by another thread) since this node was created.
+template <typename Evaluator>
+void Node<Evaluator>::narrowWindow(int newAlpha, int newBeta)
+{
+	if (alpha < newAlpha)
+	{
+		alpha = newAlpha;
+	}
+	if (initialAlpha < newAlpha)
 	{
-		return globalState().currentHeuristic(state);
+		initialAlpha = newAlpha;
 	}
+	if (beta > newBeta)
+	{
+		beta = newBeta;
+	}
+	if (initialBeta > newBeta)
+	{
+		initialBeta = newBeta;
+	}
+}
 
+template <typename Evaluator>
+int Node<Evaluator>::getValue() const
+{
 	return value;
 }
 
-void Node::updateParent()
+template <typename Evaluator>
+int Node<Evaluator>::getAlpha() const
+{
+	return alpha;
+}
+
+template <typename Evaluator>
+int Node<Evaluator>::getBeta() const
+{
+	return beta;
+}
+
+template <typename Evaluator>
+uint8_t Node<Evaluator>::getDepth() const
+{
+	return depth;
+}
+
+template <typename Evaluator>
+SearchContext& Node<Evaluator>::getContext() const
+{
+	return *context;
+}
+
+template <typename Evaluator>
+void Node<Evaluator>::updateParent()
 {
 	if (parent)
 	{
+		storeInTable();
 		parent->update(*this);
 	}
 }
 
+// Look this position up in the transposition table. A matching entry
+// either settles the node's value outright, so no children get expanded,
+// or narrows the alpha-beta window the children are searched with.
+//
+// Only entries searched to exactly this depth are used. Deeper entries
+// would change which of several equally valued moves the AI picks, and
+// with no-op moves available that can leave both AIs passing forever.
+// Any entry's best move is still worth trying first, though, so that is
+// returned (or 0 if there is none) for move ordering.
+template <typename Evaluator>
+uint8_t Node<Evaluator>::probeTable()
+{
+	auto table = context->transpositionTable;
+	auto entry = TableEntry{};
+	if (!table || !table->probe(state.getHash(), entry))
+	{
+		return 0;
+	}
+	if (!parent || entry.depth != depth)
+	{
+		return entry.bestMove;
+	}
+
+	if (entry.bound == Bound::EXACT
+			|| (entry.bound == Bound::LOWER && entry.value >= beta)
+			|| (entry.bound == Bound::UPPER && entry.value <= alpha))
+	{
+		value = entry.value;
+		fromTable = true;
+	}
+	else if (entry.bound == Bound::LOWER && entry.value > alpha)
+	{
+		alpha = entry.value;
+	}
+	else if (entry.bound == Bound::UPPER && entry.value < beta)
+	{
+		beta = entry.value;
+	}
+	initialAlpha = alpha;
+	initialBeta = beta;
+	return entry.bestMove;
+}
+
+// Remember the result of a finished search below this node. Whether the
+// value is exact or only a bound depends on the window it was searched with.
+template <typename Evaluator>
+void Node<Evaluator>::storeInTable() const
+{
+	auto table = context->transpositionTable;
+	if (!table || fromTable || bestMove.empty() || depth == 0
+			|| isTerminalState())
+	{
+		return;
+	}
+
+	auto bound = Bound::EXACT;
+	if (context->prune && value <= initialAlpha)
+	{
+		bound = Bound::UPPER;
+	}
+	else if (context->prune && value >= initialBeta)
+	{
+		bound = Bound::LOWER;
+	}
+	table->store(state.getHash(), value, depth, bound,
+			encodeMove(bestMove.front()));
+}
+
+// The heuristic's score for this node's own position, worked out the
+// first time it is needed
+template <typename Evaluator>
+int Node<Evaluator>::staticEvaluation()
+{
+	if (!evaluated)
+	{
+		staticValue = Evaluator::evaluate(state, p1IsMaximizer);
+		evaluated = true;
+	}
+	return staticValue;
+}
+
 // Call this when it looks like you have two equally good child nodes.
 // True means prefer the new child, false means keep the current best move.
-bool Node::tiebreaker(const Node& newChild) const
+template <typename Evaluator>
+bool Node<Evaluator>::tiebreaker(Node& newChild)
 {
 	// If we have no current best move, obviously prefer the new child
-	if (bestMove == nullptr)
+	if (bestMove.empty())
 	{
 		return true;
 	}
@@ -106,24 +331,16 @@ bool Node::tiebreaker(const Node& newChild) const
 	// analysis shows that if the opponent plays perfectly, it doesn't
 	// matter what I do", and going with the first move it thinks of,
 	// which often leads to a stalemate.
-	auto bestMoves = *bestMove;
-	auto projectedBestState = state;
-	while (!bestMoves.empty())
-	{
-		auto& holeVector = projectedBestState.getIsP1Turn()
-				? projectedBestState.p1Holes
-				: projectedBestState.p2Holes;
-		if (holeVector[bestMoves.front().holeNumber-1] == 0)
-		{
-			// Always prefer actual moves to no-ops
-			return true;
-		}
-		applyMove(projectedBestState, bestMoves.front());
-		bestMoves.pop();
+	//
+	// Both scores were saved when the children reported to us, so nothing
+	// needs to be replayed here.
+	if (bestMovePasses)
+	{
+		// Always prefer actual moves to no-ops
+		return true;
 	}
 
-	auto diff = globalState().currentHeuristic(projectedBestState)
-			- globalState().currentHeuristic(newChild.state);
+	auto diff = bestMoveValue - newChild.staticEvaluation();
 	if (maximizer)
 	{
 		// diff == 0 means keep old move, so return false (keep old)
@@ -140,18 +357,23 @@ bool Node::tiebreaker(const Node& newChild) const
 	}
 }
 
-void Node::update(const Node& child)
+// Makes child's move our best move, remembering what tiebreaker() needs
+template <typename Evaluator>
+void Node<Evaluator>::takeBestMove(Node& child)
 {
-	if (value == child.getValue() && tiebreaker(child))
+	bestMove = child.action;
+	bestMoveValue = child.staticEvaluation();
+	bestMovePasses = child.actionPasses;
+}
+
+template <typename Evaluator>
+void Node<Evaluator>::update(Node& child)
+{
+	const auto wasCutoff = isCutoff();
+	const auto childValue = child.getValue();
+	if (value == childValue && tiebreaker(child))
 	{
-		if (bestMove)
-		{
-			*bestMove = *child.action;
-		}
-		else
-		{
-			bestMove = std::make_unique<std::queue<Move> >(*child.action);
-		}
+		takeBestMove(child);
 	}
 
 	if (maximizer)
@@ -160,19 +382,12 @@ void Node::update(const Node& child)
 		//		<< ", b=" << beta << ", v=" << value << ")"
 		//		<< " updating on " << child.getValue() << std::endl;
 
-		if (value < child.getValue())
+		if (value < childValue)
 		{
-			value = child.getValue();
-			if (bestMove)
-			{
-				*bestMove = *child.action;
-			}
-			else
-			{
-				bestMove = std::make_unique<std::queue<Move> >(*child.action);
-			}
+			value = childValue;
+			takeBestMove(child);
 			//std::cout << "New value: " << value << " (";
-			//printMoves(*bestMove);
+			//printMoves(bestMove);
 			//std::cout << ")" << std::endl;
 		}
 
@@ -181,7 +396,7 @@ void Node::update(const Node& child)
 			alpha = value;
 
 			//std::cout << "New alpha: " << value << " (";
-			//printMoves(*bestMove);
+			//printMoves(bestMove);
 			//std::cout << ")" << std::endl;
 		}
 	}
@@ -191,20 +406,13 @@ void Node::update(const Node& child)
 		//		<< ", b=" << beta << ", v=" << value << ")"
 		//		<< " updating on " << child.getValue() << std::endl;
 
-		if (value > child.getValue()
-				|| (value == child.getValue() && tiebreaker(child)))
+		if (value > childValue
+				|| (value == childValue && tiebreaker(child)))
 		{
-			value = child.getValue();
-			if (bestMove)
-			{
-				*bestMove = *child.action;
-			}
-			else
-			{
-				bestMove = std::make_unique<std::queue<Move> >(*child.action);
-			}
+			value = childValue;
+			takeBestMove(child);
 			//std::cout << "New value: " << value << " (";
-			//printMoves(*bestMove);
+			//printMoves(bestMove);
 			//std::cout << ")" << std::endl;
 		}
 
@@ -212,74 +420,111 @@ void Node::update(const Node& child)
 		{
 			beta = value;
 			//std::cout << "New beta: " << beta << " (";
-			//printMoves(*bestMove);
+			//printMoves(bestMove);
 			//std::cout << ")" << std::endl;
 		}
 	}
+
+	// Tell the move orderer which move refuted this position, so that it
+	// gets tried early in similar positions too. This and the counts go to
+	// the child's thread, which is the one reporting it: a node other
+	// threads steal children from belongs to a different thread.
+	if (isCutoff() && !child.action.empty())
+	{
+		child.thread->orderer(*context).cutoff(state, ply, depth,
+				child.action.front());
+	}
+	if (isCutoff() && !wasCutoff)
+	{
+		child.thread->stats.countCutoff(movesTried);
+	}
 }
 
-bool Node::isTerminalState() const
+template <typename Evaluator>
+bool Node<Evaluator>::isTerminalState() const
 {
 	return state.isEndState();
 }
 
-std::queue<Move> Node::getBestMove() const
+template <typename Evaluator>
+const MoveSequence& Node<Evaluator>::getBestMove() const
 {
-	assert(bestMove != nullptr);
-	return *bestMove;
+	assert(!bestMove.empty());
+	return bestMove;
 }
 
-std::ostream& Node::print(std::ostream& stream) const
+// False until at least one child has reported its value
+template <typename Evaluator>
+bool Node<Evaluator>::hasBestMove() const
+{
+	return !bestMove.empty();
+}
+
+// Whether ancestor is our parent, or its parent, and so on
+template <typename Evaluator>
+bool Node<Evaluator>::isBelow(const Node& ancestor) const
+{
+	for (auto node = parent; node; node = node->parent)
+	{
+		if (node == &ancestor)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+template <typename Evaluator>
+std::ostream& Node<Evaluator>::print(std::ostream& stream) const
 {
 	stream << "Node{ depth=" << static_cast<int>(depth) << ", "
 			<< "State{ " << state << " }, Action=";
-	if (action)
+	if (!action.empty())
 	{
-		printMoves(*action);
+		printMoves(action);
 	}
 	else
 	{
 		stream << "null";
 	}
 	stream << ", BestMove=";
-	if (bestMove)
+	if (!bestMove.empty())
 	{
-		printMoves(*bestMove);
+		printMoves(bestMove);
 	}
 	else
 	{
 		stream << "null";
 	}
-	stream << ", value=" << globalState().currentHeuristic(state);
+	stream << ", value=" << Evaluator::evaluate(state, p1IsMaximizer);
 	stream << ", alpha=" << alpha << ", beta=" << beta << " ";
 	return stream << " }";
 }
 
-std::ostream& operator<<(std::ostream& stream, const Node& node)
+template <typename Evaluator>
+std::ostream& operator<<(std::ostream& stream, const Node<Evaluator>& node)
 {
 	return node.print(stream);
 }
 
-/**
- * First heuristic is simple: the number of stones the current player
- * has captured, minus the number of stones the opponent has captured.
- */
-int calculateHeuristic1(const State& state, bool p1IsMaximizer)
+template class Node<Heuristic1Evaluator>;
+template class Node<Heuristic2Evaluator>;
+template std::ostream& operator<<(std::ostream& stream,
+		const Node<Heuristic1Evaluator>& node);
+template std::ostream& operator<<(std::ostream& stream,
+		const Node<Heuristic2Evaluator>& node);
+
+namespace
 {
-	auto diff = 0;
-	if (p1IsMaximizer)
-	{
-		diff = static_cast<int>(state.p1Captures) - state.p2Captures;
-	}
-	else
-	{
-		diff = static_cast<int>(state.p2Captures) - state.p1Captures;
-	}
 
+// Heuristic 1 for a game in which the maximizer has captured diff more
+// stones than the minimizer so far, and which may have ended
+int scoreCaptures(int diff, bool ended)
+{
 	diff = diff * 2;
 
 	// Place a high value on actually winning the game
-	if (state.isEndState())
+	if (ended)
 	{
 		if (diff > 0)
 		{
@@ -298,32 +543,55 @@ int calculateHeuristic1(const State& state, bool p1IsMaximizer)
 	return diff;
 }
 
-int calculateHeuristic2(const State& state, bool p1IsMaximizer)
+}
+
+/**
+ * First heuristic is simple: the number of stones the current player
+ * has captured, minus the number of stones the opponent has captured.
+ */
+int calculateHeuristic1(const State& state, bool p1IsMaximizer)
 {
-	auto h = 130*calculateHeuristic1(state, p1IsMaximizer);
-	auto maximizerStones = 0;
-	auto minimizerStones = 0;
-	for (auto val : state.p1Holes)
+	auto diff = 0;
+	if (p1IsMaximizer)
 	{
-		if (p1IsMaximizer)
-		{
-			maximizerStones += val;
-		}
-		else
-		{
-			minimizerStones += val;
-		}
+		diff = static_cast<int>(state.p1Captures()) - state.p2Captures();
 	}
-	for (auto val : state.p2Holes)
+	else
 	{
-		if (!p1IsMaximizer)
-		{
-			maximizerStones += val;
-		}
-		else
-		{
-			minimizerStones += val;
-		}
+		diff = static_cast<int>(state.p2Captures()) - state.p1Captures();
 	}
+	return scoreCaptures(diff, state.isEndState());
+}
+
+int calculateHeuristic2(const State& state, bool p1IsMaximizer)
+{
+	auto h = 130*calculateHeuristic1(state, p1IsMaximizer);
+	const auto maximizer = p1IsMaximizer ? 0 : 1;
+	auto maximizerStones = static_cast<int>(state.holeStones[maximizer]);
+	auto minimizerStones = static_cast<int>(state.holeStones[1 - maximizer]);
 	return h + maximizerStones - minimizerStones;
 }
+
+/**
+ * Heuristic 1 for where perfect play from state ends up, P1 capturing
+ * p1Lead more of the stones left than P2.
+ *
+ * If the tablebase says the game doesn't end, play goes round forever, and
+ * that is scored as a draw by repetition: the captures stand, but with no
+ * bonus for ending the game.
+ */
+int solvedHeuristic1(const State& state, int p1Lead, bool ends,
+		bool p1IsMaximizer)
+{
+	const auto p1Diff = static_cast<int>(state.p1Captures())
+			- state.p2Captures() + p1Lead;
+	return scoreCaptures(p1IsMaximizer ? p1Diff : -p1Diff, ends);
+}
+
+// No stones are left in the holes once the game ends, and the ones going
+// round forever in a draw by repetition never count for anyone
+int solvedHeuristic2(const State& state, int p1Lead, bool ends,
+		bool p1IsMaximizer)
+{
+	return 130*solvedHeuristic1(state, p1Lead, ends, p1IsMaximizer);
+}
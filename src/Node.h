@@ -8,51 +8,88 @@
 #ifndef SRC_NODE_H_
 #define SRC_NODE_H_
 
+#include "Evaluator.h"
 #include "State.h"
 #include "Move.h"
 #include "MoveIterator.h"
 #include <cstdint>
-#include <memory>
-#include <stack>
-#include <queue>
 #include <iosfwd>
+struct SearchContext;
+struct SearchThread;
 
+/**
+ * A position in the search tree. Evaluator scores the leaves (see
+ * Evaluator.h); the nodes of one search all share the same Evaluator.
+ */
+template <typename Evaluator>
 class Node
 {
 public:
-	explicit Node(const State& state, uint8_t depth, bool maximizer);
+	explicit Node(SearchContext& context, const State& state, uint8_t depth,
+			bool maximizer);
+	explicit Node(SearchContext& context, SearchThread& thread,
+			const State& state);
 	Node(const Node&) = delete;
 	Node& operator=(Node&) = delete;
 	Node& operator=(Node&&) = default;
 	Node(Node&&) = default;
-	void expandNextNode(std::stack<Node>& fringe);
+	void nextChildInto(Node& child);
+	Node nextChild();
 	bool hasNextNode() const;
+	bool isCutoff() const;
+	void narrowWindow(int newAlpha, int newBeta);
 	void updateParent();
 	int getValue() const;
-	std::queue<Move> getBestMove() const;
+	int getAlpha() const;
+	int getBeta() const;
+	uint8_t getDepth() const;
+	SearchContext& getContext() const;
+	void storeInTable() const;
+	const MoveSequence& getBestMove() const;
+	bool hasBestMove() const;
+	bool isBelow(const Node& ancestor) const;
 	std::ostream& print(std::ostream& stream) const;
 private:
+	SearchContext* context;
+	SearchThread* thread; // whose stats and orderer this node updates
 	State state;
 	Node* parent;
-	std::unique_ptr<std::queue<Move> > action;
+	MoveSequence action;
 	uint8_t depth;
 	int alpha;
 	int beta;
 	int value;
 	bool maximizer;
 	MoveIterator iter;
-	std::unique_ptr<std::queue<Move> > bestMove;
+	MoveSequence bestMove;
+	int initialAlpha;
+	int initialBeta;
+	bool fromTable;
+	bool p1IsMaximizer; // whether the root player, who is scored for, is P1
+	uint8_t ply;
+	uint8_t movesTried; // children created so far
+	// The heuristic's score for state, once something has asked for it
+	int staticValue;
+	bool evaluated;
+	// Whether action sowed from an empty hole at any point
+	bool actionPasses;
+	// staticValue and actionPasses of the child bestMove leads to, for
+	// tiebreaking without replaying bestMove
+	int bestMoveValue;
+	bool bestMovePasses;
 private: // Member functions
-	explicit Node(const State& state, Node* const parent,
-			std::unique_ptr<std::queue<Move> > action, uint8_t depth,
+	void reset(const State& state, Node* const parent,
+			const MoveSequence& action, uint8_t depth,
 			int alpha, int beta, bool maximizer);
-	bool tiebreaker(const Node& equalChild) const;
-	void update(const Node& child);
+	int staticEvaluation();
+	bool tiebreaker(Node& equalChild);
+	void takeBestMove(Node& child);
+	void update(Node& child);
 	bool isTerminalState() const;
+	uint8_t probeTable();
 };
 
-std::ostream& operator<<(std::ostream& stream, const Node& node);
-int calculateHeuristic1(const State& state, bool p1IsMaximizer);
-int calculateHeuristic2(const State& state, bool p1IsMaximizer);
+template <typename Evaluator>
+std::ostream& operator<<(std::ostream& stream, const Node<Evaluator>& node);
 
 #endif /* SRC_NODE_H_ */
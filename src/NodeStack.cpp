@@ -0,0 +1,28 @@
+/*
+ * NodeStack.cpp
+ *
+ *  Created on: Mar 23, 2016
+ *      Author: derek
+ */
+
+#include "NodeStack.h"
+#include "Evaluator.h"
+#include "State.h"
+
+// A stack for searching depth plies below a node with state's board size,
+// on the thread that keeps its things in thread
+template <typename Evaluator>
+NodeStack<Evaluator>::NodeStack(SearchContext& context, SearchThread& thread,
+		const State& state, std::size_t depth)
+: frames{},
+  used{0}
+{
+	frames.reserve(depth);
+	for (std::size_t i = 0; i < depth; ++i)
+	{
+		frames.emplace_back(context, thread, state);
+	}
+}
+
+template class NodeStack<Heuristic1Evaluator>;
+template class NodeStack<Heuristic2Evaluator>;
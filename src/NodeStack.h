@@ -0,0 +1,53 @@
+/*
+ * NodeStack.h
+ *
+ *  Created on: Mar 23, 2016
+ *      Author: derek
+ */
+
+#ifndef SRC_NODESTACK_H_
+#define SRC_NODESTACK_H_
+
+#include "Node.h"
+#include <cassert>
+#include <cstddef>
+#include <vector>
+struct SearchContext;
+struct SearchThread;
+struct State;
+
+/**
+ * The fringe of a depth-first search: one node frame per ply, in a single
+ * array allocated when the stack is made. Pushing a child resets the next
+ * frame in place, so the search loop never allocates, and the frames never
+ * move, so children can keep pointing back at their parents.
+ */
+template <typename Evaluator>
+class NodeStack
+{
+public:
+	NodeStack(SearchContext& context, SearchThread& thread, const State& state,
+			std::size_t depth);
+	NodeStack(const NodeStack&) = delete;
+	NodeStack& operator=(const NodeStack&) = delete;
+	bool empty() const { return used == 0; }
+	std::size_t size() const { return used; }
+	Node<Evaluator>& top() { return frames[used - 1]; }
+	Node<Evaluator>& operator[](std::size_t i) { return frames[i]; }
+
+	// Expands parent's next child into the frame above the top
+	void push(Node<Evaluator>& parent)
+	{
+		assert(used < frames.size());
+		parent.nextChildInto(frames[used]);
+		used += 1;
+	}
+
+	void pop() { used -= 1; }
+	void clear() { used = 0; }
+private:
+	std::vector<Node<Evaluator> > frames;
+	std::size_t used;
+};
+
+#endif /* SRC_NODESTACK_H_ */
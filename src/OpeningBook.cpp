@@ -0,0 +1,211 @@
+/*
+ * OpeningBook.cpp
+ *
+ *  Created on: Mar 17, 2016
+ *      Author: derek
+ */
+
+#include "OpeningBook.h"
+#include "MoveIterator.h"
+#include "Search.h"
+#include "Settings.h"
+#include "State.h"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <unordered_set>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+
+struct BookHeader
+{
+	char magic[4];
+	uint8_t heuristic; // the Heuristic the book was searched with
+	uint8_t depth;     // and how deep
+	uint16_t reserved;
+	uint64_t entries;
+};
+
+const char MAGIC[4] = {'M', 'O', 'B', '2'};
+
+}
+
+// Identifies a position along with the board size it was reached on
+uint64_t bookKey(const State& state)
+{
+	const auto config = static_cast<uint64_t>(state.getConfig().numStones) << 8
+			| state.getConfig().numHoles;
+	return state.getHash() ^ (config * 0x9E3779B97F4A7C15);
+}
+
+OpeningBook::OpeningBook()
+: mapping{nullptr},
+  mappingSize{0},
+  entries{nullptr},
+  numEntries{0},
+  heuristic{Heuristic::H1},
+  depth{0}
+{
+}
+
+OpeningBook::~OpeningBook()
+{
+	if (mapping)
+	{
+		munmap(mapping, mappingSize);
+	}
+}
+
+// Maps the book in path into memory. Returns false if it can't be read.
+bool OpeningBook::open(const std::string& path)
+{
+	assert(!mapping);
+	auto fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+	{
+		return false;
+	}
+	struct stat info;
+	if (fstat(fd, &info) != 0
+			|| static_cast<std::size_t>(info.st_size) < sizeof(BookHeader))
+	{
+		close(fd);
+		return false;
+	}
+	auto size = static_cast<std::size_t>(info.st_size);
+	auto address = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (address == MAP_FAILED)
+	{
+		return false;
+	}
+	mapping = address;
+	mappingSize = size;
+
+	auto header = BookHeader{};
+	std::memcpy(&header, mapping, sizeof(header));
+	if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0
+			|| size != sizeof(header) + header.entries * sizeof(BookEntry)
+			|| (header.heuristic != static_cast<uint8_t>(Heuristic::H1)
+					&& header.heuristic != static_cast<uint8_t>(Heuristic::H2)))
+	{
+		return false;
+	}
+	heuristic = static_cast<Heuristic>(header.heuristic);
+	depth = header.depth;
+	entries = reinterpret_cast<const BookEntry*>(
+			static_cast<const char*>(mapping) + sizeof(header));
+	numEntries = header.entries;
+	return true;
+}
+
+/**
+ * Sets turn to the book's choice for state, if it has one and was searched
+ * the way the caller would have: with searchHeuristic, to searchDepth. A
+ * caller with no fixed depth, such as one playing on a clock, passes 0 to
+ * take the book at whatever depth it was built.
+ */
+bool OpeningBook::lookup(const State& state, Heuristic searchHeuristic,
+		int searchDepth, MoveSequence& turn) const
+{
+	if (searchHeuristic != heuristic
+			|| (searchDepth != 0 && searchDepth != depth))
+	{
+		return false;
+	}
+
+	const auto key = bookKey(state);
+	const auto end = entries + numEntries;
+	const auto entry = std::lower_bound(entries, end, key,
+			[](const BookEntry& e, uint64_t k) { return e.key < k; });
+	if (entry == end || entry->key != key)
+	{
+		return false;
+	}
+
+	turn.clear();
+	for (auto i = 0; i < entry->length; ++i)
+	{
+		turn.push(decodeMove(entry->moves[i]));
+	}
+	return true;
+}
+
+std::size_t OpeningBook::size() const
+{
+	return numEntries;
+}
+
+/**
+ * Searches every position reachable in the first few turns of a game on
+ * each of the given board sizes, and writes the best turn for each to
+ * path. The player to move in each position is scored with heuristic.
+ */
+bool buildOpeningBook(SearchContext& context, const std::string& path,
+		const BookConfigs& configs, int turns, int depth,
+		Heuristic heuristic)
+{
+	auto book = std::vector<BookEntry>{};
+	for (const auto& config : configs)
+	{
+		const GameConfig game{config.first, config.second};
+
+		// Go through the game tree a turn at a time, skipping positions
+		// that more than one line of play leads to
+		auto seen = std::unordered_set<uint64_t>{};
+		auto frontier = std::vector<State>{State{game}};
+		seen.insert(bookKey(frontier.front()));
+		for (auto turn = 0; turn < turns && !frontier.empty(); ++turn)
+		{
+			auto next = std::vector<State>{};
+			for (const auto& state : frontier)
+			{
+				// Zero the padding too, so the same book always comes out
+				auto entry = BookEntry{};
+				std::memset(&entry, 0, sizeof(entry));
+				entry.key = bookKey(state);
+				auto best = searchBestTurn(context, state, depth, heuristic);
+				entry.length = best.size();
+				for (auto i = 0; i < best.size(); ++i)
+				{
+					entry.moves[i] = encodeMove(best[i]);
+				}
+				book.push_back(entry);
+
+				for (auto iter = MoveIterator{state}; iter.isValid(); iter.next())
+				{
+					const auto& child = iter.resultingState();
+					if (!child.isEndState() && seen.insert(bookKey(child)).second)
+					{
+						next.push_back(child);
+					}
+				}
+			}
+			std::cout << config.first << " stones, " << config.second
+					<< " holes: searched " << frontier.size()
+					<< " positions after " << turn << " turns" << std::endl;
+			frontier = std::move(next);
+		}
+	}
+
+	std::sort(book.begin(), book.end(),
+			[](const BookEntry& a, const BookEntry& b) { return a.key < b.key; });
+	auto header = BookHeader{};
+	std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.heuristic = static_cast<uint8_t>(heuristic);
+	header.depth = depth;
+	header.reserved = 0;
+	header.entries = book.size();
+	auto file = std::ofstream{path, std::ios::binary};
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(reinterpret_cast<const char*>(book.data()),
+			book.size() * sizeof(BookEntry));
+	return static_cast<bool>(file);
+}
@@ -0,0 +1,66 @@
+/*
+ * OpeningBook.h
+ *
+ *  Created on: Mar 17, 2016
+ *      Author: derek
+ */
+
+#ifndef SRC_OPENINGBOOK_H_
+#define SRC_OPENINGBOOK_H_
+
+#include "Evaluator.h"
+#include "Move.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+struct SearchContext;
+struct State;
+
+// One book position, as stored in the file
+struct BookEntry
+{
+	uint64_t key;   // see bookKey()
+	uint8_t length; // of the turn below
+	uint8_t moves[MAX_TURN_LENGTH]; // encodeMove() codes
+};
+
+/**
+ * Best turns for the positions near the start of a game, worked out ahead
+ * of time by buildOpeningBook().
+ *
+ * The file is a sorted array of BookEntry, mapped read-only and looked up
+ * by binary search. Its header says which heuristic and depth the turns
+ * were searched with, and only players searching the same way use them.
+ */
+class OpeningBook
+{
+public:
+	OpeningBook();
+	OpeningBook(const OpeningBook&) = delete;
+	OpeningBook& operator=(const OpeningBook&) = delete;
+	~OpeningBook();
+	bool open(const std::string& path);
+	bool lookup(const State& state, Heuristic searchHeuristic,
+			int searchDepth, MoveSequence& turn) const;
+	std::size_t size() const;
+private:
+	void* mapping;
+	std::size_t mappingSize;
+	const BookEntry* entries;
+	std::size_t numEntries;
+	Heuristic heuristic; // what the book was searched with
+	int depth;
+};
+
+uint64_t bookKey(const State& state);
+
+// Board sizes (stones, holes) to build a book for
+using BookConfigs = std::vector<std::pair<int, int> >;
+
+bool buildOpeningBook(SearchContext& context, const std::string& path,
+		const BookConfigs& configs, int turns, int depth,
+		Heuristic heuristic);
+
+#endif /* SRC_OPENINGBOOK_H_ */
@@ -0,0 +1,203 @@
+/*
+ * Perft.cpp
+ *
+ *  Created on: Mar 18, 2016
+ *      Author: derek
+ */
+
+#include "Perft.h"
+#include "Move.h"
+#include "MoveIterator.h"
+#include "Settings.h"
+#include "State.h"
+#include "ThreadPool.h"
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <utility>
+#include <vector>
+
+namespace
+{
+
+struct PerftReference
+{
+	int stones;
+	int holes;
+	int depth;
+	PerftUnit unit;
+	uint64_t nodes;
+};
+
+// Counts from the starting position, which any change to applyMove or
+// MoveIterator must reproduce. Checked against the original, queue-based
+// move generator.
+const PerftReference REFERENCE[] = {
+	{2, 1, 1, PerftUnit::TURN, 2},
+	{2, 2, 5, PerftUnit::TURN, 9116},
+	{3, 3, 4, PerftUnit::TURN, 130670},
+	{3, 4, 3, PerftUnit::TURN, 917342},
+	{4, 4, 3, PerftUnit::TURN, 29464},
+	{4, 6, 1, PerftUnit::TURN, 15654},
+	{5, 5, 3, PerftUnit::TURN, 48970},
+	{6, 6, 3, PerftUnit::TURN, 65880},
+	{2, 2, 12, PerftUnit::MOVE, 1218448},
+	{3, 3, 9, PerftUnit::MOVE, 9556308},
+	{4, 4, 8, PerftUnit::MOVE, 16771392},
+	{5, 5, 7, PerftUnit::MOVE, 10000000},
+};
+
+// Every child one ply down from state, with the moves that lead to it
+std::vector<std::pair<MoveSequence, State> > children(const State& state,
+		PerftUnit unit)
+{
+	auto result = std::vector<std::pair<MoveSequence, State> >{};
+	if (state.isEndState())
+	{
+		return result;
+	}
+	if (unit == PerftUnit::TURN)
+	{
+		for (auto iter = MoveIterator{state}; iter.isValid(); iter.next())
+		{
+			result.emplace_back(*iter, iter.resultingState());
+		}
+	}
+	else
+	{
+		for (auto hole = 1; hole <= state.getConfig().numHoles; ++hole)
+		{
+			for (auto clockwise : {false, true})
+			{
+				auto child = state;
+				auto move = MoveSequence{};
+				move.push(Move(hole, clockwise));
+				applyMove(child, move.front());
+				result.emplace_back(move, child);
+			}
+		}
+	}
+	return result;
+}
+
+}
+
+uint64_t perft(const State& state, int depth, PerftUnit unit, bool bulk)
+{
+	if (depth == 0)
+	{
+		return 1;
+	}
+	if (state.isEndState())
+	{
+		return 0;
+	}
+
+	auto nodes = uint64_t{0};
+	if (unit == PerftUnit::TURN)
+	{
+		for (auto iter = MoveIterator{state}; iter.isValid(); iter.next())
+		{
+			if (bulk && depth == 1)
+			{
+				nodes += 1;
+				continue;
+			}
+			nodes += perft(iter.resultingState(), depth - 1, unit, bulk);
+		}
+	}
+	else
+	{
+		if (bulk && depth == 1)
+		{
+			return 2 * state.getConfig().numHoles;
+		}
+		for (auto hole = 1; hole <= state.getConfig().numHoles; ++hole)
+		{
+			for (auto clockwise : {false, true})
+			{
+				auto child = state;
+				applyMove(child, Move(hole, clockwise));
+				nodes += perft(child, depth - 1, unit, bulk);
+			}
+		}
+	}
+	return nodes;
+}
+
+uint64_t perftDivide(const State& state, int depth, PerftUnit unit,
+		bool bulk, ThreadPool* pool)
+{
+	const auto start = std::chrono::steady_clock::now();
+	auto nodes = uint64_t{1};
+	if (depth > 0)
+	{
+		auto moves = children(state, unit);
+		auto counts = std::vector<uint64_t>(moves.size());
+		std::atomic<std::size_t> next{0};
+		auto countMoves = [&](int)
+		{
+			for (auto i = next++; i < moves.size(); i = next++)
+			{
+				counts[i] = perft(moves[i].second, depth - 1, unit, bulk);
+			}
+		};
+		if (pool)
+		{
+			pool->runOnAll(countMoves);
+		}
+		else
+		{
+			countMoves(0);
+		}
+
+		nodes = 0;
+		for (std::size_t i = 0; i < moves.size(); ++i)
+		{
+			printMoves(moves[i].first);
+			std::cout << " " << counts[i] << std::endl;
+			nodes += counts[i];
+		}
+	}
+
+	const auto elapsed = std::chrono::duration<double>(
+			std::chrono::steady_clock::now() - start).count();
+	std::cout << "Nodes: " << nodes << std::endl;
+	std::cout << "Time: " << static_cast<int>(elapsed * 1000) << " ms"
+			<< std::endl;
+	std::cout << "Nodes/sec: "
+			<< static_cast<uint64_t>(elapsed > 0 ? nodes / elapsed : 0)
+			<< std::endl;
+	return nodes;
+}
+
+bool perftCheck()
+{
+	auto passed = true;
+	for (const auto& reference : REFERENCE)
+	{
+		const GameConfig game{reference.stones, reference.holes};
+
+		const auto start = std::chrono::steady_clock::now();
+		const auto nodes = perft(State{game}, reference.depth, reference.unit,
+				true);
+		const auto elapsed = std::chrono::duration<double>(
+				std::chrono::steady_clock::now() - start).count();
+
+		std::cout << reference.stones << " stones, " << reference.holes
+				<< " holes, " << reference.depth
+				<< (reference.unit == PerftUnit::TURN ? " turns: " : " moves: ")
+				<< nodes << " (" << static_cast<uint64_t>(
+						elapsed > 0 ? nodes / elapsed : 0) << " nodes/sec)";
+		if (nodes == reference.nodes)
+		{
+			std::cout << " ok" << std::endl;
+		}
+		else
+		{
+			std::cout << " expected " << reference.nodes << std::endl;
+			passed = false;
+		}
+	}
+	return passed;
+}
@@ -0,0 +1,41 @@
+/*
+ * Perft.h
+ *
+ *  Created on: Mar 18, 2016
+ *      Author: derek
+ */
+
+#ifndef SRC_PERFT_H_
+#define SRC_PERFT_H_
+
+#include <cstdint>
+struct State;
+class ThreadPool;
+
+/**
+ * Counting the game tree to a fixed depth ("perft", after the chess
+ * engines' test of the same name). If two versions of the move generator
+ * disagree on a count, at least one of them is wrong, and the time taken
+ * measures how fast the generator is.
+ */
+enum class PerftUnit
+{
+	TURN, // a ply is a player's whole turn, as MoveIterator generates it
+	MOVE  // a ply is a single sowing, so bonus moves are separate plies
+};
+
+// Number of positions exactly depth plies below state. Games that end
+// sooner don't count. With bulk, the last ply is counted without making
+// its moves.
+uint64_t perft(const State& state, int depth, PerftUnit unit, bool bulk);
+
+// Prints the count below each of state's moves, the total and the speed.
+// The moves are shared out over pool, if there is one.
+uint64_t perftDivide(const State& state, int depth, PerftUnit unit,
+		bool bulk, ThreadPool* pool);
+
+// Checks the counts in this file's table of known results, returning
+// false if any of them have changed.
+bool perftCheck();
+
+#endif /* SRC_PERFT_H_ */
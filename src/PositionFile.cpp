@@ -0,0 +1,194 @@
+/*
+ * PositionFile.cpp
+ *
+ *  Created on: Mar 22, 2016
+ *      Author: derek
+ */
+
+#include "PositionFile.h"
+#include "Settings.h"
+#include "State.h"
+#include <cassert>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+
+struct PositionHeader
+{
+	char magic[4];
+	uint8_t stones;
+	uint8_t holes;
+	uint16_t reserved;
+	uint64_t records;
+};
+
+const char MAGIC[4] = {'M', 'P', 'F', '1'};
+
+void writeHeader(std::ofstream& file, int stones, int holes,
+		uint64_t records)
+{
+	auto header = PositionHeader{};
+	std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.stones = stones;
+	header.holes = holes;
+	header.reserved = 0;
+	header.records = records;
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+}
+
+}
+
+// Fills in record's position and side to move, with no score or best move
+void storePosition(const State& state, PositionRecord& record)
+{
+	std::memcpy(record.board, state.board, sizeof(record.board));
+	record.flags = state.getIsP1Turn() ? POSITION_P1_TO_MOVE : 0;
+	record.bestMove = 0;
+	record.score = 0;
+	record.reserved = 0;
+}
+
+/**
+ * Sets state, which must be for the record's board size, to the record's
+ * position. Returns false, leaving state as it was, if the record can't be
+ * a position on that board: flags this file format doesn't have, stones in
+ * holes past the last one, or a total other than the board's.
+ */
+bool loadPosition(const PositionRecord& record, State& state)
+{
+	const auto& config = state.getConfig();
+	const auto knownFlags = POSITION_P1_TO_MOVE | POSITION_HAS_SCORE
+			| POSITION_HAS_BEST_MOVE;
+	if ((record.flags & ~knownFlags) != 0)
+	{
+		return false;
+	}
+	for (auto i = config.numHoles; i < MAX_HOLES; ++i)
+	{
+		if (record.board[P1_HOLES + i] != 0 || record.board[P2_HOLES + i] != 0)
+		{
+			return false;
+		}
+	}
+	auto total = 0;
+	for (auto stones : record.board)
+	{
+		total += stones;
+	}
+	if (total != config.totalStones())
+	{
+		return false;
+	}
+
+	std::memcpy(state.board, record.board, sizeof(state.board));
+	if (state.getIsP1Turn() != ((record.flags & POSITION_P1_TO_MOVE) != 0))
+	{
+		state.nextTurn();
+	}
+	state.rehash();
+	return true;
+}
+
+PositionFile::PositionFile()
+: mapping{nullptr},
+  mappingSize{0},
+  records{nullptr},
+  numRecords{0},
+  stones{0},
+  holes{0}
+{
+}
+
+PositionFile::~PositionFile()
+{
+	if (mapping)
+	{
+		munmap(mapping, mappingSize);
+	}
+}
+
+// Maps the position file in path into memory. Returns false if it can't
+// be read.
+bool PositionFile::open(const std::string& path)
+{
+	assert(!mapping);
+	auto fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+	{
+		return false;
+	}
+	struct stat info;
+	if (fstat(fd, &info) != 0
+			|| static_cast<std::size_t>(info.st_size) < sizeof(PositionHeader))
+	{
+		close(fd);
+		return false;
+	}
+	auto size = static_cast<std::size_t>(info.st_size);
+	auto address = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (address == MAP_FAILED)
+	{
+		return false;
+	}
+	mapping = address;
+	mappingSize = size;
+
+	// Readers go through the records in order, so read well ahead
+	madvise(mapping, mappingSize, MADV_SEQUENTIAL);
+
+	auto header = PositionHeader{};
+	std::memcpy(&header, mapping, sizeof(header));
+	if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0
+			|| header.holes < 1 || header.holes > MAX_HOLES
+			|| size != sizeof(header)
+					+ header.records * sizeof(PositionRecord))
+	{
+		return false;
+	}
+	records = reinterpret_cast<const PositionRecord*>(
+			static_cast<const char*>(mapping) + sizeof(header));
+	numRecords = header.records;
+	stones = header.stones;
+	holes = header.holes;
+	return true;
+}
+
+bool isPositionFile(const std::string& path)
+{
+	char magic[sizeof(MAGIC)] = {};
+	auto file = std::ifstream{path, std::ios::binary};
+	file.read(magic, sizeof(magic));
+	return file && std::memcmp(magic, MAGIC, sizeof(MAGIC)) == 0;
+}
+
+PositionWriter::PositionWriter(const std::string& path,
+		const GameConfig& config)
+: file{path, std::ios::binary},
+  numRecords{0},
+  stones{config.numStones},
+  holes{config.numHoles}
+{
+	writeHeader(file, stones, holes, 0);
+}
+
+void PositionWriter::write(const PositionRecord& record)
+{
+	file.write(reinterpret_cast<const char*>(&record), sizeof(record));
+	numRecords += 1;
+}
+
+// Fills in the header and closes the file. Returns false if anything
+// couldn't be written.
+bool PositionWriter::close()
+{
+	file.seekp(0);
+	writeHeader(file, stones, holes, numRecords);
+	file.close();
+	return static_cast<bool>(file);
+}
@@ -0,0 +1,92 @@
+/*
+ * PositionFile.h
+ *
+ *  Created on: Mar 22, 2016
+ *      Author: derek
+ */
+
+#ifndef SRC_POSITIONFILE_H_
+#define SRC_POSITIONFILE_H_
+
+#include "Move.h"
+#include "State.h"
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+struct GameConfig;
+
+// One position, as stored in the file. The board is laid out just as in
+// State, so loading a record is a copy and a rehash.
+struct PositionRecord
+{
+	uint8_t board[BOARD_SIZE];
+	uint8_t flags;    // the POSITION_ bits below
+	uint8_t bestMove; // encodeMove() code of the best turn's first move
+	int32_t score;    // for the player to move
+	uint32_t reserved;
+};
+
+constexpr uint8_t POSITION_P1_TO_MOVE = 1;
+constexpr uint8_t POSITION_HAS_SCORE = 2;
+constexpr uint8_t POSITION_HAS_BEST_MOVE = 4;
+
+static_assert(sizeof(PositionRecord) == 32,
+		"PositionRecord must stay the same size in every build");
+
+void storePosition(const State& state, PositionRecord& record);
+bool loadPosition(const PositionRecord& record, State& state);
+
+/**
+ * A file of positions for one board size, mapped read-only. The records
+ * are used where they lie in the mapping, so going through them costs no
+ * more than reading the file, and any number of threads can share one.
+ */
+class PositionFile
+{
+public:
+	PositionFile();
+	PositionFile(const PositionFile&) = delete;
+	PositionFile& operator=(const PositionFile&) = delete;
+	~PositionFile();
+	bool open(const std::string& path);
+	int getStones() const { return stones; }
+	int getHoles() const { return holes; }
+	std::size_t size() const { return numRecords; }
+	const PositionRecord* begin() const { return records; }
+	const PositionRecord* end() const { return records + numRecords; }
+	const PositionRecord& operator[](std::size_t i) const { return records[i]; }
+private:
+	void* mapping;
+	std::size_t mappingSize;
+	const PositionRecord* records;
+	std::size_t numRecords;
+	int stones;
+	int holes;
+};
+
+// Whether path starts like a position file, so tools can take either kind
+// of input
+bool isPositionFile(const std::string& path);
+
+/**
+ * Writes a position file for the board size of config. The record count
+ * in the header is only filled in by close(), so a file that wasn't closed
+ * won't open.
+ */
+class PositionWriter
+{
+public:
+	PositionWriter(const std::string& path, const GameConfig& config);
+	PositionWriter(const PositionWriter&) = delete;
+	PositionWriter& operator=(const PositionWriter&) = delete;
+	void write(const PositionRecord& record);
+	bool close();
+private:
+	std::ofstream file;
+	uint64_t numRecords;
+	int stones;
+	int holes;
+};
+
+#endif /* SRC_POSITIONFILE_H_ */
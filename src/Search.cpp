@@ -0,0 +1,333 @@
+/*
+ * Search.cpp
+ *
+ *  Created on: Mar 12, 2016
+ *      Author: derek
+ */
+
+#include "Search.h"
+#include "Negamax.h"
+#include "Node.h"
+#include "NodeStack.h"
+#include "SearchThread.h"
+#include "Settings.h"
+#include "ThreadPool.h"
+#include "YoungBrothers.h"
+#include <atomic>
+#include <cassert>
+#include <vector>
+
+namespace
+{
+
+// Lifts shared to at least value, even if other threads are doing the same
+void raiseShared(std::atomic<int>& shared, int value)
+{
+	auto current = shared.load();
+	while (current < value && !shared.compare_exchange_weak(current, value))
+	{
+	}
+}
+
+/**
+ * Searches the root's children on every thread of the pool.
+ *
+ * All root moves are generated up front, and each thread repeatedly claims
+ * the next unsearched one and runs an ordinary search below it with its own
+ * fringe. Finished children raise a shared alpha, so children started later
+ * get a narrower window. That alpha is lowered by one before use, so a child
+ * that ties the best move so far still gets an exact value and not a bound.
+ *
+ * The children are then merged into the root one at a time in move order,
+ * as the sequential search would. Since every child that could tie for the
+ * best move has an exact value, the chosen move doesn't depend on which
+ * thread finished first.
+ *
+ * It can still differ from the sequential search's, which gives its later
+ * root children the unlowered alpha: a child that ties the best move there
+ * only returns a bound, and tiebreaker() compares bounds and exact values
+ * alike. So the value is the same for any thread count, but with more than
+ * one thread a different move of the same value may be chosen.
+ */
+template <typename Evaluator>
+SearchResult searchRootInParallel(SearchContext& context, const State& state,
+		uint8_t depth)
+{
+	reserveSearchThreads(context, context.threadPool->size());
+	auto& mainThread = *context.threads[0];
+	mainThread.stats = SearchStats{};
+	auto root = Node<Evaluator>{context, state, depth, true};
+	auto children = std::vector<Node<Evaluator> >{};
+	while (root.hasNextNode())
+	{
+		children.push_back(root.nextChild());
+		if ((children.size() & CLOCK_CHECK_MASK) == 0
+				&& checkSearchClock(context))
+		{
+			break;
+		}
+	}
+
+	const auto noAlpha = -99999999;
+	std::atomic<int> sharedAlpha{noAlpha};
+	std::atomic<std::size_t> nextChild{0};
+	std::atomic<int> nodesExpanded{static_cast<int>(children.size())};
+	auto stats = std::vector<SearchStats>(context.threadPool->size());
+	const auto rootStats = mainThread.stats;
+	auto finished = std::vector<char>(children.size(), false);
+
+	context.threadPool->runOnAll([&](int thread)
+	{
+		auto& self = *context.threads[thread];
+		self.stats = SearchStats{};
+		NodeStack<Evaluator> fringe{context, self, state,
+				static_cast<std::size_t>(depth - 1)};
+		auto expanded = 0;
+		for (auto i = nextChild++; i < children.size(); i = nextChild++)
+		{
+			// Children at the search horizon cost nothing to finish, so
+			// they still get counted after the deadline
+			auto& child = children[i];
+			if (searchStopped(context) && child.getDepth() > 0)
+			{
+				break;
+			}
+			auto alpha = sharedAlpha.load();
+			if (alpha != noAlpha)
+			{
+				alpha -= 1;
+				child.narrowWindow(alpha, child.getBeta());
+			}
+			expanded += searchBelow(child, fringe);
+			if (searchStopped(context) && child.getDepth() > 0)
+			{
+				break;
+			}
+			finished[i] = true;
+			if (child.getValue() > alpha)
+			{
+				raiseShared(sharedAlpha, child.getValue());
+			}
+		}
+		nodesExpanded += expanded;
+		stats[thread] = self.stats;
+	});
+
+	// The root's counts, which merging the children adds to, go back on
+	// this thread; the workers' counts are added after
+	mainThread.stats = rootStats;
+	for (std::size_t i = 0; i < children.size(); ++i)
+	{
+		if (finished[i])
+		{
+			children[i].updateParent();
+		}
+	}
+	for (const auto& threadTotals : stats)
+	{
+		mainThread.stats += threadTotals;
+	}
+	if (searchStopped(context))
+	{
+		auto partial = root.hasBestMove() ? root.getBestMove()
+				: MoveSequence{};
+		return SearchResult{partial, root.getValue(),
+				nodesExpanded.load(), mainThread.stats, false, 0};
+	}
+	root.storeInTable();
+	return SearchResult{root.getBestMove(), root.getValue(),
+			nodesExpanded.load(), mainThread.stats, true, 0};
+}
+
+/**
+ * searchToDepth() for one evaluator, which every node below is compiled
+ * with.
+ */
+template <typename Evaluator>
+SearchResult searchToDepthWith(SearchContext& context, const State& state,
+		uint8_t depth, int guess)
+{
+	if (context.algorithm == Algorithm::PVS && context.prune)
+	{
+		return searchPrincipalVariation<Evaluator>(context, state, depth,
+				guess);
+	}
+	if (context.algorithm == Algorithm::MTDF && context.prune)
+	{
+		return searchMtdf<Evaluator>(context, state, depth, guess);
+	}
+	if (context.threadPool && context.threadPool->size() > 1)
+	{
+		if (context.workStealing)
+		{
+			return searchYoungBrothersWait<Evaluator>(context, state, depth);
+		}
+		return searchRootInParallel<Evaluator>(context, state, depth);
+	}
+
+	auto& thread = *context.threads[0];
+	thread.stats = SearchStats{};
+	auto root = Node<Evaluator>{context, state, depth, true};
+	NodeStack<Evaluator> fringe{context, thread, state, depth};
+	auto nodesExpanded = searchBelow(root, fringe);
+	if (searchStopped(context))
+	{
+		auto partial = root.hasBestMove() ? root.getBestMove()
+				: MoveSequence{};
+		return SearchResult{partial, root.getValue(),
+				nodesExpanded, thread.stats, false, 0};
+	}
+
+	// Remember the best move so the next, deeper iteration tries it first
+	root.storeInTable();
+	return SearchResult{root.getBestMove(), root.getValue(),
+			nodesExpanded, thread.stats, true, 0};
+}
+
+}
+
+/**
+ * Runs the usual depth-first search below base until base has no more
+ * children to expand. Nodes are pushed on top of fringe, which must be
+ * empty to start with and have a frame for each ply below base, and base
+ * itself is never popped.
+ *
+ * If the search deadline passes, the fringe is emptied without reporting
+ * anything further to base; check searchStopped() before using it.
+ * The deadline is the one in base's context.
+ *
+ * Returns the number of nodes expanded.
+ */
+template <typename Evaluator>
+int searchBelow(Node<Evaluator>& base, NodeStack<Evaluator>& fringe)
+{
+	assert(fringe.empty());
+	auto& context = base.getContext();
+	auto nodesExpanded = 0;
+	while (true)
+	{
+		auto& node = fringe.empty() ? base : fringe.top();
+		//cout << "AI is evaluating move " << node << endl;
+
+		if (node.hasNextNode())
+		{
+			nodesExpanded += 1;
+			if ((nodesExpanded & CLOCK_CHECK_MASK) == 0
+					&& checkSearchClock(context))
+			{
+				fringe.clear();
+				break;
+			}
+
+			// Expand the next node, and make that the top of the stack
+			fringe.push(node);
+			// Following ordinary stack rules, we can only ever operate on the
+			// top element, so go back to the start of the loop.
+		}
+		else
+		{
+			// This section applies to nodes that have no children, either
+			// because we've maxed out the depth of our search, or because
+			// we've already evaluated all the children.
+			if (!fringe.empty())
+			{
+				// Evaluate the node and update its parents
+				node.updateParent();
+				fringe.pop();
+			}
+			else
+			{
+				// We're back at the base node now, so end the loop
+				// If you pop it, you won't be able to retrieve its data
+				break;
+			}
+		}
+	}
+	return nodesExpanded;
+}
+
+template int searchBelow(Node<Heuristic1Evaluator>& base,
+		NodeStack<Heuristic1Evaluator>& fringe);
+template int searchBelow(Node<Heuristic2Evaluator>& base,
+		NodeStack<Heuristic2Evaluator>& fringe);
+
+/**
+ * Finds the best move for the player to move in state, looking depth
+ * turns ahead. The root is always the maximizer.
+ *
+ * guess is the value of a shallower search of the same position, if there
+ * was one. Searches that use aspiration windows centre them on it.
+ */
+SearchResult searchToDepth(SearchContext& context, const State& state,
+		uint8_t depth, int guess)
+{
+	switch (context.heuristic)
+	{
+	case Heuristic::H1:
+		return searchToDepthWith<Heuristic1Evaluator>(context, state, depth,
+				guess);
+	case Heuristic::H2:
+		return searchToDepthWith<Heuristic2Evaluator>(context, state, depth,
+				guess);
+	}
+	assert(false);
+	return SearchResult{};
+}
+
+/**
+ * Deepens one ply at a time down to depth without printing anything, and
+ * returns the best turn for the player to move, scored with heuristic.
+ */
+MoveSequence searchBestTurn(SearchContext& context, const State& state,
+		int depth, Heuristic heuristic)
+{
+	context.heuristic = heuristic;
+	if (context.transpositionTable)
+	{
+		context.transpositionTable->newSearch();
+	}
+	context.searchId += 1;
+
+	auto result = SearchResult{};
+	for (auto d = 1; d <= depth; ++d)
+	{
+		result = searchToDepth(context, state, d,
+				d > 1 ? result.value : NO_GUESS);
+	}
+	return result.bestMove;
+}
+
+/**
+ * Makes searches in context give up once deadline passes. They only look
+ * at the clock every so often, so they may run slightly over.
+ */
+void setSearchDeadline(SearchContext& context,
+		std::chrono::steady_clock::time_point when)
+{
+	context.deadline = when;
+	context.hasDeadline = true;
+	context.stopped = false;
+}
+
+void clearSearchDeadline(SearchContext& context)
+{
+	context.hasDeadline = false;
+	context.stopped = false;
+}
+
+// Whether some thread has noticed that the deadline passed
+bool searchStopped(const SearchContext& context)
+{
+	return context.stopped.load(std::memory_order_relaxed);
+}
+
+// Reads the clock, and returns whether the search should stop
+bool checkSearchClock(SearchContext& context)
+{
+	if (context.hasDeadline
+			&& std::chrono::steady_clock::now() >= context.deadline)
+	{
+		context.stopped.store(true, std::memory_order_relaxed);
+	}
+	return searchStopped(context);
+}
@@ -0,0 +1,55 @@
+/*
+ * Search.h
+ *
+ *  Created on: Mar 12, 2016
+ *      Author: derek
+ */
+
+#ifndef SRC_SEARCH_H_
+#define SRC_SEARCH_H_
+
+#include "Evaluator.h"
+#include "Move.h"
+#include "Settings.h"
+#include "State.h"
+#include <chrono>
+#include <cstdint>
+template <typename Evaluator> class Node;
+template <typename Evaluator> class NodeStack;
+
+// Searches look at the clock once every CLOCK_CHECK_MASK + 1 expansions.
+// Reading the clock costs about as much as expanding a node, so this keeps
+// deadlines nearly free.
+const int CLOCK_CHECK_MASK = 1023;
+
+// Passed to searchToDepth() when there is no earlier value to aim at
+const int NO_GUESS = -1999999999;
+
+struct SearchResult
+{
+	MoveSequence bestMove;
+	int value;
+	int nodesExpanded;
+	SearchStats stats;
+	// False if the deadline cut the search short. bestMove and value then
+	// only cover the root moves that were searched in full, if any.
+	bool complete;
+	// Times the root was searched, for searches that may search it again
+	// with different windows; 0 for the others
+	int passes;
+};
+
+SearchResult searchToDepth(SearchContext& context, const State& state,
+		uint8_t depth, int guess = NO_GUESS);
+MoveSequence searchBestTurn(SearchContext& context, const State& state,
+		int depth, Heuristic heuristic);
+template <typename Evaluator>
+int searchBelow(Node<Evaluator>& base, NodeStack<Evaluator>& fringe);
+
+void setSearchDeadline(SearchContext& context,
+		std::chrono::steady_clock::time_point deadline);
+void clearSearchDeadline(SearchContext& context);
+bool searchStopped(const SearchContext& context);
+bool checkSearchClock(SearchContext& context);
+
+#endif /* SRC_SEARCH_H_ */
@@ -0,0 +1,47 @@
+/*
+ * SearchThread.cpp
+ *
+ *  Created on: Mar 24, 2016
+ *      Author: derek
+ */
+
+#include "SearchThread.h"
+#include <memory>
+
+SearchThread::SearchThread(unsigned searchId)
+: stats{},
+  natural{},
+  killerHistory{},
+  searchId{searchId}
+{
+}
+
+/**
+ * The orderer for this thread, as chosen by context.moveOrdering. It is
+ * cleared automatically the first time it's used in a new search.
+ */
+MoveOrderer& SearchThread::orderer(const SearchContext& context)
+{
+	MoveOrderer& orderer = context.moveOrdering == Ordering::NATURAL
+			? static_cast<MoveOrderer&>(natural) : killerHistory;
+	if (searchId != context.searchId)
+	{
+		orderer.clear();
+		searchId = context.searchId;
+	}
+	return orderer;
+}
+
+/**
+ * Gives context a SearchThread for each of the first count threads of its
+ * pool, if it hasn't got them yet. Call this before a search goes
+ * parallel, not while other threads are using context.
+ */
+void reserveSearchThreads(SearchContext& context, std::size_t count)
+{
+	while (context.threads.size() < count)
+	{
+		context.threads.push_back(
+				std::make_unique<SearchThread>(context.searchId));
+	}
+}
@@ -0,0 +1,37 @@
+/*
+ * SearchThread.h
+ *
+ *  Created on: Mar 24, 2016
+ *      Author: derek
+ */
+
+#ifndef SRC_SEARCHTHREAD_H_
+#define SRC_SEARCHTHREAD_H_
+
+#include "MoveOrdering.h"
+#include "Settings.h"
+#include <cstddef>
+
+/**
+ * What one thread of a search keeps to itself: its statistics and its
+ * move orderers. Each SearchContext has its own, one for every thread its
+ * searches run on, so the threads never share them and need no locks.
+ */
+struct SearchThread
+{
+public: /* Member functions */
+	explicit SearchThread(unsigned searchId);
+	SearchThread(const SearchThread&) = delete;
+	SearchThread& operator=(const SearchThread&) = delete;
+	MoveOrderer& orderer(const SearchContext& context);
+
+public: /* Data members */
+	SearchStats stats;
+	NaturalOrderer natural;
+	KillerHistoryOrderer killerHistory;
+	unsigned searchId; // the search the orderers have learned from
+};
+
+void reserveSearchThreads(SearchContext& context, std::size_t count);
+
+#endif /* SRC_SEARCHTHREAD_H_ */
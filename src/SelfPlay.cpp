@@ -0,0 +1,208 @@
+/*
+ * SelfPlay.cpp
+ *
+ *  Created on: Mar 19, 2016
+ *      Author: derek
+ */
+
+#include "SelfPlay.h"
+#include "Move.h"
+#include "MoveIterator.h"
+#include "Node.h"
+#include "Search.h"
+#include "Settings.h"
+#include "State.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace
+{
+
+struct SelfPlayHeader
+{
+	char magic[4];
+	uint32_t reserved;
+	uint64_t games;
+};
+
+const char MAGIC[4] = {'M', 'S', 'P', '1'};
+
+std::string workerPath(const std::string& path, int worker)
+{
+	return path + ".worker" + std::to_string(worker);
+}
+
+// Plays one game, leaving its moves in moves
+GameRecord playGame(SearchContext& context, const GameConfig& config,
+		uint32_t game, const SelfPlaySettings& settings,
+		std::vector<uint8_t>& moves)
+{
+	// Each game has its own seed, so it comes out the same however the
+	// games are shared out between workers
+	std::seed_seq seeds{static_cast<uint32_t>(settings.seed),
+			static_cast<uint32_t>(settings.seed >> 32), game};
+	std::mt19937_64 random{seeds};
+	auto book = settings.openingBook;
+
+	moves.clear();
+	auto state = State{config};
+	auto turns = 0;
+	for (; turns < MAX_GAME_TURNS && !state.isEndState(); ++turns)
+	{
+		auto turn = MoveSequence{};
+		if (turns < settings.randomTurns)
+		{
+			auto choices = std::vector<MoveSequence>{};
+			for (auto iter = MoveIterator{state}; iter.isValid(); iter.next())
+			{
+				choices.push_back(*iter);
+			}
+			auto pick = std::uniform_int_distribution<std::size_t>{0,
+					choices.size() - 1};
+			turn = choices[pick(random)];
+		}
+		else
+		{
+			auto heuristic = state.getIsP1Turn() ? settings.p1 : settings.p2;
+			if (!book || !book->lookup(state, heuristic, settings.depth, turn))
+			{
+				turn = searchBestTurn(context, state, settings.depth,
+						heuristic);
+			}
+		}
+
+		applyMoves(state, turn);
+		for (auto i = 0; i < turn.size(); ++i)
+		{
+			moves.push_back(encodeMove(turn[i]));
+		}
+	}
+
+	auto record = GameRecord{};
+	std::memset(&record, 0, sizeof(record));
+	record.game = game;
+	record.stones = config.numStones;
+	record.holes = config.numHoles;
+	record.depth = settings.depth;
+	record.heuristics = static_cast<uint8_t>(settings.p1)
+			| static_cast<uint8_t>(settings.p2) << 4;
+	record.randomTurns = settings.randomTurns;
+	record.p1Captures = state.p1Captures();
+	record.p2Captures = state.p2Captures();
+	record.finished = state.isEndState();
+	record.numMoves = moves.size();
+	return record;
+}
+
+// Plays every workers'th game, starting at game number worker, with a
+// search context and transposition table of its own
+bool playWorkerGames(const std::string& path, const GameConfig& config,
+		const SelfPlaySettings& settings, int worker)
+{
+	SearchContext context;
+	context.moveOrdering = settings.moveOrdering;
+	context.algorithm = settings.algorithm;
+	context.tablebase = settings.tablebase;
+	auto table = std::unique_ptr<TranspositionTable>{};
+	if (settings.tableMegabytes > 0)
+	{
+		table = std::make_unique<TranspositionTable>(settings.tableMegabytes,
+				settings.tableReplacement);
+		context.transpositionTable = table.get();
+	}
+
+	auto file = std::ofstream{path, std::ios::binary};
+	auto moves = std::vector<uint8_t>{};
+	for (auto game = worker; game < settings.games; game += settings.workers)
+	{
+		const auto record = playGame(context, config, game, settings, moves);
+		file.write(reinterpret_cast<const char*>(&record), sizeof(record));
+		file.write(reinterpret_cast<const char*>(moves.data()), moves.size());
+	}
+	file.close();
+	return static_cast<bool>(file);
+}
+
+}
+
+/**
+ * Plays settings.games games of the AI against itself on the board given by
+ * config, and writes them all to path in game order.
+ *
+ * The games are shared out between the threads of a pool. Each worker
+ * writes its games to a file of its own, and the files are merged at the
+ * end.
+ */
+bool playSelfPlayGames(const std::string& path, const GameConfig& config,
+		const SelfPlaySettings& settings)
+{
+	const auto start = std::chrono::steady_clock::now();
+	auto workersOk = std::vector<char>(settings.workers, false);
+	ThreadPool pool{settings.workers};
+	pool.runOnAll([&](int worker)
+	{
+		workersOk[worker] = playWorkerGames(workerPath(path, worker), config,
+				settings, worker);
+	});
+	auto ok = std::all_of(workersOk.begin(), workersOk.end(),
+			[](char workerOk) { return workerOk; });
+
+	auto inputs = std::vector<std::ifstream>{};
+	for (auto worker = 0; ok && worker < settings.workers; ++worker)
+	{
+		inputs.emplace_back(workerPath(path, worker), std::ios::binary);
+	}
+
+	auto header = SelfPlayHeader{};
+	std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.reserved = 0;
+	header.games = settings.games;
+	auto file = std::ofstream{path, std::ios::binary};
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+	// Worker w played games w, w + workers, w + 2 * workers, ...
+	auto p1Wins = 0;
+	auto p2Wins = 0;
+	auto unfinished = 0;
+	auto moves = std::vector<char>{};
+	for (auto game = 0; ok && game < settings.games; ++game)
+	{
+		auto& input = inputs[game % settings.workers];
+		auto record = GameRecord{};
+		input.read(reinterpret_cast<char*>(&record), sizeof(record));
+		moves.resize(record.numMoves);
+		input.read(moves.data(), moves.size());
+		ok = input && record.game == static_cast<uint32_t>(game);
+		file.write(reinterpret_cast<const char*>(&record), sizeof(record));
+		file.write(moves.data(), moves.size());
+
+		unfinished += !record.finished;
+		p1Wins += record.finished && record.p1Captures > record.p2Captures;
+		p2Wins += record.finished && record.p2Captures > record.p1Captures;
+	}
+	inputs.clear();
+	for (auto worker = 0; worker < settings.workers; ++worker)
+	{
+		std::remove(workerPath(path, worker).c_str());
+	}
+	if (!ok || !file)
+	{
+		return false;
+	}
+
+	const auto elapsed = std::chrono::duration<double>(
+			std::chrono::steady_clock::now() - start).count();
+	std::cout << settings.games << " games in " << elapsed << " s: P1 won "
+			<< p1Wins << ", P2 won " << p2Wins << ", "
+			<< settings.games - p1Wins - p2Wins - unfinished << " tied, "
+			<< unfinished << " unfinished" << std::endl;
+	return true;
+}
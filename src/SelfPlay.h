@@ -0,0 +1,61 @@
+/*
+ * SelfPlay.h
+ *
+ *  Created on: Mar 19, 2016
+ *      Author: derek
+ */
+
+#ifndef SRC_SELFPLAY_H_
+#define SRC_SELFPLAY_H_
+
+#include "Settings.h"
+#include "TranspositionTable.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Games that go on this long are stopped and recorded as unfinished.
+// Both players can pass forever, so some games would never end.
+constexpr int MAX_GAME_TURNS = 500;
+
+// One game, as stored in the file. The moves follow it, one encodeMove()
+// byte per sowing; replaying them shows where each turn ends.
+struct GameRecord
+{
+	uint32_t game;       // number of the game in its run, from 0
+	uint8_t stones;
+	uint8_t holes;
+	uint8_t depth;
+	uint8_t heuristics;  // P1's Heuristic in the low four bits, P2's above
+	uint8_t randomTurns; // opening turns chosen at random, not searched
+	uint8_t p1Captures;
+	uint8_t p2Captures;
+	uint8_t finished;    // 0 if the game hit MAX_GAME_TURNS
+	uint16_t numMoves;
+	uint16_t reserved;
+};
+
+// Most opening turns GameRecord::randomTurns can record
+constexpr int MAX_RANDOM_TURNS = 255;
+
+struct SelfPlaySettings
+{
+	int games;
+	int depth;
+	int randomTurns;
+	int workers;
+	uint64_t seed;
+	Heuristic p1;
+	Heuristic p2;
+	std::size_t tableMegabytes; // for each worker's own table
+	ReplacementPolicy tableReplacement;
+	Ordering moveOrdering;
+	Algorithm algorithm;
+	const Tablebase* tablebase; // shared by all workers; may be null
+	const OpeningBook* openingBook;
+};
+
+bool playSelfPlayGames(const std::string& path, const GameConfig& config,
+		const SelfPlaySettings& settings);
+
+#endif /* SRC_SELFPLAY_H_ */
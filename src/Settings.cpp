@@ -6,29 +6,101 @@
  */
 
 #include "Settings.h"
+#include "SearchThread.h"
+#include <algorithm>
 
-uint8_t GlobalState::totalStones() const
+GameConfig::GameConfig(int numStones, int numHoles)
+: numStones{numStones},
+  numHoles{numHoles},
+  sowing{}
+{
+	buildSowingTable(*this, sowing);
+}
+
+uint8_t GameConfig::totalStones() const
 {
 	return numHoles * 2 * numStones;
 }
 
-GlobalState& globalState()
+SearchContext::SearchContext()
+: prune{true},
+  heuristic{Heuristic::H2},
+  moveOrdering{Ordering::KILLER_HISTORY},
+  algorithm{Algorithm::ALPHA_BETA},
+  searchId{0},
+  transpositionTable{nullptr},
+  tablebase{nullptr},
+  threadPool{nullptr},
+  workStealing{false},
+  hasDeadline{false},
+  deadline{},
+  stopped{false},
+  threads{}
+{
+	reserveSearchThreads(*this, 1);
+}
+
+SearchContext::~SearchContext()
+{
+}
+
+Settings::Settings()
+: game{std::make_unique<GameConfig>(4, 4)},
+  search{},
+  searchDepth{1},
+  iterativeDeepening{false},
+  p1Heuristic{Heuristic::H2},
+  p2Heuristic{Heuristic::H2},
+  playouts{20000},
+  p1NextMoveFn{nullptr},
+  p2NextMoveFn{nullptr},
+  tableMegabytes{64},
+  tableReplacement{ReplacementPolicy::DEPTH},
+  transpositionTable{nullptr},
+  numThreads{1},
+  threadPool{nullptr},
+  clockMilliseconds{0},
+  moveMilliseconds{0},
+  timeManager{nullptr},
+  tablebasePath{""},
+  tablebase{nullptr},
+  bookPath{""},
+  openingBook{nullptr},
+  statsPath{""},
+  statsFile{nullptr}
+{
+}
+
+// Counts a turn of sowings generated ply turns below the root
+void SearchStats::countTurn(int ply, int sowings)
+{
+	turns += 1;
+	this->sowings += sowings;
+	longestTurn = std::max(longestTurn, sowings);
+	if (ply <= MAX_SEARCH_DEPTH)
+	{
+		nodesAtPly[ply] += 1;
+	}
+}
+
+// Counts a node whose window closed after movesTried of its moves
+void SearchStats::countCutoff(int movesTried)
 {
-	static GlobalState gs;
-	return gs;
+	betaCutoffs += 1;
+	firstMoveCutoffs += movesTried == 1;
 }
 
-void initializeGlobals()
+SearchStats& SearchStats::operator+=(const SearchStats& other)
 {
-	globalState().numHoles = 4;
-	globalState().numStones = 4;
-	globalState().searchDepth = 1;
-	globalState().prune = true;
-	globalState().prunedNodes = 0;
-	globalState().p1Heuristic = nullptr;
-	globalState().p2Heuristic = nullptr;
-	globalState().p1NextMoveFn = nullptr;
-	globalState().p2NextMoveFn = nullptr;
-	globalState().currentHeuristic = nullptr;
-	globalState().iterativeDeepening = false;
+	betaCutoffs += other.betaCutoffs;
+	firstMoveCutoffs += other.firstMoveCutoffs;
+	leafEvaluations += other.leafEvaluations;
+	turns += other.turns;
+	sowings += other.sowings;
+	longestTurn = std::max(longestTurn, other.longestTurn);
+	for (auto ply = 0; ply <= MAX_SEARCH_DEPTH; ++ply)
+	{
+		nodesAtPly[ply] += other.nodesAtPly[ply];
+	}
+	return *this;
 }
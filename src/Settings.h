@@ -8,33 +8,150 @@
 #ifndef SRC_SETTINGS_H_
 #define SRC_SETTINGS_H_
 
+#include "Evaluator.h"
+#include "OpeningBook.h"
+#include "Sowing.h"
+#include "Tablebase.h"
+#include "ThreadPool.h"
+#include "TimeManager.h"
+#include "TranspositionTable.h"
+#include <atomic>
+#include <chrono>
+#include <cstddef>
 #include <cstdint>
+#include <fstream>
 #include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+struct SearchThread;
 class State;
 
-using HeuristicFn = std::function<int(const State&)>;
+constexpr int MAX_SEARCH_DEPTH = 20;
+
+enum class Ordering
+{
+	NATURAL,       // the order MoveIterator generates moves in
+	KILLER_HISTORY // see KillerHistoryOrderer
+};
+
+enum class Algorithm
+{
+	ALPHA_BETA, // minimax over Nodes, see Search.cpp
+	PVS,        // principal variation search, see Negamax.cpp
+	MTDF        // MTD(f), likewise
+};
+
 using NextMoveFn = std::function<State(const State& currentState)>;
 
-struct GlobalState
+/**
+ * The board a game is played on, and the sowing tables worked out for it.
+ * Every State points at the config it was made for, so a config can't be
+ * copied and must outlive its states.
+ */
+struct GameConfig
 {
 public: /* Member functions */
+	GameConfig(int numStones, int numHoles);
+	GameConfig(const GameConfig&) = delete;
+	GameConfig& operator=(const GameConfig&) = delete;
 	uint8_t totalStones() const;
 
 public: /* Data members */
 	int numStones;
 	int numHoles;
-	int searchDepth;
+	SowingTable sowing;
+};
+
+/**
+ * Everything a search reads besides the position itself. Searches that
+ * have contexts of their own share nothing, so they can run at the same
+ * time without locking.
+ */
+struct SearchContext
+{
+public: /* Member functions */
+	SearchContext();
+	~SearchContext();
+	SearchContext(const SearchContext&) = delete;
+	SearchContext& operator=(const SearchContext&) = delete;
+
+public: /* Data members */
 	bool prune;
-	int prunedNodes;
+	Heuristic heuristic;   // scores positions for the root player
+	Ordering moveOrdering;
+	Algorithm algorithm;
+	unsigned searchId;     // bumped for every new root position
+	TranspositionTable* transpositionTable; // these three may be null
+	const Tablebase* tablebase;
+	ThreadPool* threadPool;
+	bool workStealing;
+	bool hasDeadline;      // see setSearchDeadline()
+	std::chrono::steady_clock::time_point deadline;
+	std::atomic<bool> stopped;
+	// Thread i of threadPool keeps its own things in threads[i], and the
+	// thread that starts a search is 0 (see reserveSearchThreads())
+	std::vector<std::unique_ptr<SearchThread> > threads;
+};
+
+/**
+ * What the command line asked for, along with the tables and threads set
+ * up to match. Only main() and the commands it runs see this; the search
+ * itself only sees the GameConfig and SearchContext.
+ */
+struct Settings
+{
+public: /* Member functions */
+	Settings();
+	Settings(const Settings&) = delete;
+	Settings& operator=(const Settings&) = delete;
+
+public: /* Data members */
+	std::unique_ptr<GameConfig> game;
+	SearchContext search;
+	int searchDepth;
 	bool iterativeDeepening;
-	HeuristicFn p1Heuristic;
-	HeuristicFn p2Heuristic;
+	Heuristic p1Heuristic; // only used by AI players
+	Heuristic p2Heuristic;
+	int playouts;          // for each ai-mcts search, or 0 to use the clock
 	NextMoveFn p1NextMoveFn;
 	NextMoveFn p2NextMoveFn;
-	HeuristicFn currentHeuristic;
+	std::size_t tableMegabytes;
+	ReplacementPolicy tableReplacement;
+	std::unique_ptr<TranspositionTable> transpositionTable;
+	int numThreads;
+	std::unique_ptr<ThreadPool> threadPool;
+	long clockMilliseconds;
+	long moveMilliseconds;
+	std::unique_ptr<TimeManager> timeManager;
+	std::string tablebasePath;
+	std::unique_ptr<Tablebase> tablebase;
+	std::string bookPath;
+	std::unique_ptr<OpeningBook> openingBook;
+	std::string statsPath;
+	std::unique_ptr<std::ofstream> statsFile; // JSON lines, one per iteration
 };
 
-GlobalState& globalState();
-void initializeGlobals();
+/**
+ * Counters that each search thread keeps in its SearchThread. Searches
+ * start them from zero, and report their threads' totals in
+ * SearchResult::stats.
+ */
+struct SearchStats
+{
+public: /* Member functions */
+	void countTurn(int ply, int sowings);
+	void countCutoff(int movesTried);
+	SearchStats& operator+=(const SearchStats& other);
+
+public: /* Data members */
+	int betaCutoffs;      // nodes whose window closed before they were done
+	int firstMoveCutoffs; // of those, the ones closed by their first move
+	int leafEvaluations;  // positions scored at the horizon or game over
+	int turns;            // turns generated
+	int sowings;          // in those turns, so bonus moves count extra
+	int longestTurn;      // in sowings
+	int nodesAtPly[MAX_SEARCH_DEPTH + 1]; // turns generated at each ply
+};
 
 #endif /* SRC_SETTINGS_H_ */
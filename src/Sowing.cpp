@@ -0,0 +1,89 @@
+/*
+ * Sowing.cpp
+ *
+ *  Created on: Mar 9, 2016
+ *      Author: derek
+ */
+
+#include "Sowing.h"
+#include "HoleIterator.h"
+#include "Move.h"
+#include "Settings.h"
+#include "State.h"
+#include "Zobrist.h"
+#include <cassert>
+#include <cstring>
+
+/**
+ * Fills in the sowing tables for config's number of holes.
+ *
+ * The tables are recorded by walking a HoleIterator over a scratch state,
+ * so they follow exactly the same hole order (and mancala skipping) as the
+ * iterator does. applyMove then only has to look squares up.
+ *
+ * A lap passes every hole on the board and the player's mancala twice,
+ * whichever hole it starts from and whichever way it goes.
+ */
+void buildSowingTable(const GameConfig& config, SowingTable& table)
+{
+	assert(config.numHoles <= MAX_HOLES);
+	std::memset(table.captureFrom, NO_CAPTURE, sizeof(table.captureFrom));
+	table.mancala[0] = P1_MANCALA;
+	table.mancala[1] = P2_MANCALA;
+	table.lapLength = 2 * config.numHoles + 2;
+	std::memset(table.lapStones, 0, sizeof(table.lapStones));
+
+	for (auto player = 0; player < 2; ++player)
+	{
+		auto scratch = State{config};
+		if (player == 1)
+		{
+			scratch.nextTurn();
+		}
+
+		for (auto clockwise = 0; clockwise < 2; ++clockwise)
+		{
+			for (auto hole = 1; hole <= config.numHoles; ++hole)
+			{
+				auto iter = HoleIterator{Move(hole, clockwise), scratch};
+				auto& path = table.path[player][clockwise][hole-1];
+				auto& own = table.ownHoles[player][clockwise][hole-1];
+				auto& opponent =
+						table.opponentHoles[player][clockwise][hole-1];
+				for (auto k = 0; k <= MAX_TOTAL_STONES; ++k)
+				{
+					own[k] = k > 0 ? own[k-1] : 0;
+					opponent[k] = k > 0 ? opponent[k-1] : 0;
+					if (k > 0)
+					{
+						iter.next();
+					}
+					path[k] = &*iter - scratch.board;
+					if (iter.isOwnHole())
+					{
+						table.captureFrom[player][path[k]] =
+								&iter.opposite() - scratch.board;
+					}
+					if (k > 0 && iter.isOwnHole())
+					{
+						own[k] += 1;
+					}
+					else if (k > 0 && path[k] < P1_MANCALA)
+					{
+						opponent[k] += 1;
+					}
+					assert(k < table.lapLength
+							|| path[k] == path[k - table.lapLength]);
+				}
+			}
+		}
+
+		table.lapHash[player] = 0;
+		const auto& path = table.path[player][0][0];
+		for (auto k = 1; k <= table.lapLength; ++k)
+		{
+			table.lapStones[player][path[k]] += 1;
+			table.lapHash[player] += ZOBRIST.square[path[k]];
+		}
+	}
+}
@@ -0,0 +1,74 @@
+/*
+ * Sowing.h
+ *
+ *  Created on: Mar 9, 2016
+ *      Author: derek
+ */
+
+#ifndef SRC_SOWING_H_
+#define SRC_SOWING_H_
+
+#include "State.h"
+#include <cstdint>
+struct GameConfig;
+
+// Marks board squares that never trigger a capture
+constexpr uint8_t NO_CAPTURE = 0xFF;
+
+// Lookup tables that describe every possible sowing for one board
+// configuration. Player index 0 is P1 and 1 is P2. All entries are indices
+// into State::board.
+struct SowingTable
+{
+	// path[player][clockwise][hole-1][k] is the square the k-th stone lands
+	// in, with the opponent's mancalas already skipped. Entry 0 is the hole
+	// the stones are picked up from, so path[...][stones] is the last square.
+	uint8_t path[2][2][MAX_HOLES][MAX_TOTAL_STONES + 1];
+
+	// ownHoles[player][clockwise][hole-1][k] is how many of the first k
+	// stones of that sowing land in the player's own holes, and
+	// opponentHoles likewise, so State::holeStones can be updated without
+	// looking at where each stone went.
+	uint8_t ownHoles[2][2][MAX_HOLES][MAX_TOTAL_STONES + 1];
+	uint8_t opponentHoles[2][2][MAX_HOLES][MAX_TOTAL_STONES + 1];
+
+	// captureFrom[player][square] is the opponent hole opposite square when
+	// square is one of the player's own holes, or NO_CAPTURE otherwise.
+	uint8_t captureFrom[2][BOARD_SIZE];
+
+	// Square that collects the player's captures
+	uint8_t mancala[2];
+
+	// Every path comes back to where it started after lapLength stones.
+	// lapStones[player][square] is how many stones one lap drops in square
+	// (the player's mancala is passed at both ends, so it gets two), and
+	// lapHash[player] is what one lap adds to State::hash.
+	uint8_t lapLength;
+	uint8_t lapStones[2][BOARD_SIZE];
+	uint64_t lapHash[2];
+};
+
+void buildSowingTable(const GameConfig& config, SowingTable& table);
+
+// Drops laps whole laps of stones on board: one 16-byte block, which the
+// compiler does as a single vector multiply-add, then the squares left over
+// one at a time. A plain loop over all BOARD_SIZE squares stays scalar at
+// -O2, since GCC won't pay for the vector loop's leftover iterations, and
+// without __restrict it would also need a run-time overlap check between
+// the two byte arrays.
+inline void sowLaps(uint8_t* __restrict board,
+		const uint8_t* __restrict lapStones, uint8_t laps)
+{
+	constexpr auto BLOCK = 16;
+	static_assert(BOARD_SIZE >= BLOCK, "the board fills a whole block");
+	for (auto i = 0; i < BLOCK; ++i)
+	{
+		board[i] += laps * lapStones[i];
+	}
+	for (auto i = BLOCK; i < BOARD_SIZE; ++i)
+	{
+		board[i] += laps * lapStones[i];
+	}
+}
+
+#endif /* SRC_SOWING_H_ */
@@ -7,58 +7,66 @@
 
 #include "State.h"
 #include "Settings.h"
+#include "Zobrist.h"
 #include <ostream>
 #include <iomanip>
 #include <cassert>
+#include <algorithm>
+#include <sstream>
+#include <vector>
 
-State::State()
-: p1Holes(globalState().numHoles, globalState().numStones), // Must use ()'s
-  p2Holes(globalState().numHoles, globalState().numStones), // Must use ()'s
-  p1Captures{0},
-  p2Captures{0},
+State::State(const GameConfig& config)
+: board{},
+  holeStones{},
+  hash{0},
+  config{&config},
   isP1Turn{true}
 {
+	for (auto i = 0; i < config.numHoles; ++i)
+	{
+		p1Holes()[i] = config.numStones;
+		p2Holes()[i] = config.numStones;
+	}
+	rehash();
 }
 
-State::State(std::vector<uint8_t> p1Holes,
+State::State(const GameConfig& config,
+			std::vector<uint8_t> p1Holes,
 			std::vector<uint8_t> p2Holes,
 			uint8_t p1Captures,
 			bool isP1Turn)
-: p1Holes{p1Holes},
-  p2Holes{p2Holes},
-  p1Captures{p1Captures},
-  p2Captures{0},
+: board{},
+  holeStones{},
+  hash{0},
+  config{&config},
   isP1Turn{isP1Turn}
 {
-	p2Captures = globalState().totalStones() - getUncaptured() - p1Captures;
+	assert(p1Holes.size() <= MAX_HOLES && p2Holes.size() <= MAX_HOLES);
+	std::copy(p1Holes.begin(), p1Holes.end(), this->p1Holes());
+	std::copy(p2Holes.begin(), p2Holes.end(), this->p2Holes());
+	this->p1Captures() = p1Captures;
+	rehash(); // counts the stones left, so P2's captures are the rest
+	p2Captures() = config.totalStones() - getUncaptured() - p1Captures;
+	rehash();
 }
 
 uint8_t State::getP1Captures() const
 {
-	assert(p1Captures
-				== globalState().totalStones() - getUncaptured() - p2Captures);
-	return p1Captures;
+	assert(p1Captures()
+				== config->totalStones() - getUncaptured() - p2Captures());
+	return p1Captures();
 }
 
 uint8_t State::getP2Captures() const
 {
-	assert(p2Captures
-			== globalState().totalStones() - getUncaptured() - p1Captures);
-	return p2Captures;
+	assert(p2Captures()
+			== config->totalStones() - getUncaptured() - p1Captures());
+	return p2Captures();
 }
 
 uint8_t State::getUncaptured() const
 {
-	uint8_t sum = 0;
-	for (auto c : p1Holes)
-	{
-		sum += c;
-	}
-	for (auto c : p2Holes)
-	{
-		sum += c;
-	}
-	return sum;
+	return holeStones[0] + holeStones[1];
 }
 
 bool State::getIsP1Turn() const
@@ -76,25 +84,30 @@ void State::nextTurn()
  */
 bool State::isEndState() const
 {
-	uint8_t sum = 0;
-	for (auto val : p1Holes)
-	{
-		sum += val;
-	}
-	if (sum == 0)
-	{
-		return true;
-	}
-	sum = 0;
-	for (auto val : p2Holes)
+	return holeStones[0] == 0 || holeStones[1] == 0;
+}
+
+// Identifies the position, including whose turn it is
+uint64_t State::getHash() const
+{
+	return isP1Turn ? hash : hash ^ ZOBRIST.p2ToMove;
+}
+
+// Works out hash and holeStones from scratch
+void State::rehash()
+{
+	hash = 0;
+	for (auto i = 0; i < BOARD_SIZE; ++i)
 	{
-		sum += val;
+		hash += ZOBRIST.square[i] * board[i];
 	}
-	if (sum == 0)
+	holeStones[0] = 0;
+	holeStones[1] = 0;
+	for (auto i = 0; i < MAX_HOLES; ++i)
 	{
-		return true;
+		holeStones[0] += p1Holes()[i];
+		holeStones[1] += p2Holes()[i];
 	}
-	return false;
 }
 
 std::ostream& State::print(std::ostream& stream) const
@@ -103,18 +116,19 @@ std::ostream& State::print(std::ostream& stream) const
 	{
 		stream << "*";
 	}
-	stream << static_cast<int>(p1Captures) << "/";
-	for (auto i = 0; i < p1Holes.size()-1; ++i)
+	const auto numHoles = config->numHoles;
+	stream << static_cast<int>(p1Captures()) << "/";
+	for (auto i = 0; i < numHoles-1; ++i)
 	{
-		stream << static_cast<int>(p1Holes[i]) << ",";
+		stream << static_cast<int>(p1Holes()[i]) << ",";
 	}
-	stream << static_cast<int>(p1Holes[p1Holes.size()-1]) << "/";
-	for (auto i = 0; i < p2Holes.size()-1; ++i)
+	stream << static_cast<int>(p1Holes()[numHoles-1]) << "/";
+	for (auto i = 0; i < numHoles-1; ++i)
 	{
-		stream << static_cast<int>(p2Holes[i]) << ",";
+		stream << static_cast<int>(p2Holes()[i]) << ",";
 	}
-	stream << static_cast<int>(p2Holes[p2Holes.size()-1]);
-	stream << "/" << static_cast<int>(p2Captures);
+	stream << static_cast<int>(p2Holes()[numHoles-1]);
+	stream << "/" << static_cast<int>(p2Captures());
 	if (!isP1Turn)
 	{
 		stream << "*";
@@ -136,25 +150,25 @@ std::ostream& State::prettyPrint(std::ostream& stream) const
 
 	// Column labels for usability
 	stream << "  # ";
-	for (auto i = 1; i <= globalState().numHoles; ++i)
+	for (auto i = 1; i <= config->numHoles; ++i)
 	{
 		stream << std::setfill(' ') << std::setw(3) << i << " ";
 	}
 	stream << "   " << std::endl;
 
 	stream << " * |"; // Top left mancala
-	for (auto h : p1Holes)
+	for (auto i = 0; i < config->numHoles; ++i)
 	{
 		stream << std::setfill(' ') << std::setw(3)
-		<< static_cast<int>(h) << "|";
+		<< static_cast<int>(p1Holes()[i]) << "|";
 	}
 	stream << " * "; // Top right mancala
 	stream << std::endl;
 	stream << " * |"; // Bottom left mancala
-	for (auto h : p2Holes)
+	for (auto i = 0; i < config->numHoles; ++i)
 	{
 		stream << std::setfill(' ') << std::setw(3)
-		<< static_cast<int>(h) << "|";
+		<< static_cast<int>(p2Holes()[i]) << "|";
 	}
 	stream << " * "; // Bottom right mancala
 	stream << std::endl;
@@ -165,3 +179,63 @@ std::ostream& operator<<(std::ostream& stream, const State& state)
 {
 	return state.print(stream);
 }
+
+/**
+ * Reads a state written by State::print(), e.g. "*0/4,4,4/4,4,4/0" with
+ * P1 to move. Returns false if text isn't in that format, doesn't have
+ * config.numHoles holes per side, or doesn't add up to the number of
+ * stones the game started with.
+ */
+bool parseState(const GameConfig& config, const std::string& text,
+		State& state)
+{
+	const auto numHoles = config.numHoles;
+	auto isP1Turn = !text.empty() && text.front() == '*';
+	auto isP2Turn = !text.empty() && text.back() == '*';
+	if (isP1Turn == isP2Turn)
+	{
+		return false;
+	}
+
+	auto stream = std::stringstream{text.substr(isP1Turn ? 1 : 0,
+			text.size() - 1)};
+	const auto totalStones = static_cast<int>(config.totalStones());
+	auto p1Captures = -1;
+	auto p2Captures = -1;
+	auto total = 0;
+	auto p1Holes = std::vector<uint8_t>(numHoles);
+	auto p2Holes = std::vector<uint8_t>(numHoles);
+	auto separator = ' ';
+	stream >> p1Captures >> separator;
+	for (auto row : {&p1Holes, &p2Holes})
+	{
+		if (separator != '/')
+		{
+			return false;
+		}
+		for (auto i = 0; i < numHoles; ++i)
+		{
+			auto stones = -1;
+			stream >> stones >> separator;
+			if (!stream || stones < 0 || stones > totalStones
+					|| separator != (i + 1 < numHoles ? ',' : '/'))
+			{
+				return false;
+			}
+			(*row)[i] = stones;
+			total += stones;
+		}
+	}
+	stream >> p2Captures;
+	if (!stream || p1Captures < 0 || p1Captures > totalStones
+			|| p2Captures < 0 || p2Captures > totalStones
+			|| total + p1Captures + p2Captures != totalStones)
+	{
+		return false;
+	}
+
+	// Every count fits in a byte now, so nothing wraps in the State
+	state = State{config, p1Holes, p2Holes,
+			static_cast<uint8_t>(p1Captures), isP1Turn};
+	return state.p2Captures() == p2Captures;
+}
@@ -11,12 +11,30 @@
 #include <cstdint>
 #include <vector>
 #include <iosfwd>
+#include <string>
+#include <type_traits>
+struct GameConfig;
+
+// Largest board main() accepts: 6 stones per hole and 2*(6-1) holes per side
+constexpr uint8_t MAX_STONES = 6;
+constexpr uint8_t MAX_HOLES = 2 * (MAX_STONES - 1);
+constexpr uint8_t MAX_TOTAL_STONES = 2 * MAX_HOLES * MAX_STONES;
+
+// Layout of State::board. Both rows are stored left to right as they appear
+// in prettyPrint(), so p1Holes()[i] and p2Holes()[i] are opposite each other.
+// Slots past numHoles are always zero.
+constexpr uint8_t P1_HOLES = 0;
+constexpr uint8_t P2_HOLES = MAX_HOLES;
+constexpr uint8_t P1_MANCALA = 2 * MAX_HOLES;
+constexpr uint8_t P2_MANCALA = 2 * MAX_HOLES + 1;
+constexpr uint8_t BOARD_SIZE = 2 * MAX_HOLES + 2;
 
 struct State
 {
 public: /* Member functions */
-	explicit State();
-	explicit State(std::vector<uint8_t> p1Holes,
+	explicit State(const GameConfig& config);
+	explicit State(const GameConfig& config,
+			std::vector<uint8_t> p1Holes,
 			std::vector<uint8_t> p2Holes,
 			uint8_t p1Captures,
 			bool isP1Turn);
@@ -24,19 +42,41 @@ public: /* Member functions */
 	uint8_t getP2Captures() const;
 	uint8_t getUncaptured() const;
 	bool getIsP1Turn() const;
+	const GameConfig& getConfig() const { return *config; }
 	void nextTurn();
 	bool isEndState() const;
+	uint64_t getHash() const;
+	void rehash();
 	std::ostream& prettyPrint(std::ostream& stream) const;
 	std::ostream& print(std::ostream& stream) const;
+	uint8_t* p1Holes() { return board + P1_HOLES; }
+	const uint8_t* p1Holes() const { return board + P1_HOLES; }
+	uint8_t* p2Holes() { return board + P2_HOLES; }
+	const uint8_t* p2Holes() const { return board + P2_HOLES; }
+	uint8_t& p1Captures() { return board[P1_MANCALA]; }
+	uint8_t p1Captures() const { return board[P1_MANCALA]; }
+	uint8_t& p2Captures() { return board[P2_MANCALA]; }
+	uint8_t p2Captures() const { return board[P2_MANCALA]; }
 public: /* Data members */
-	std::vector<uint8_t> p1Holes;
-	std::vector<uint8_t> p2Holes;
-	uint8_t p1Captures;
-	uint8_t p2Captures;
+	uint8_t board[BOARD_SIZE];
+	// Stones left in P1's holes and in P2's, so the heuristics and
+	// isEndState() needn't add up the rows
+	uint8_t holeStones[2];
+	// Zobrist hash of board (see Zobrist.h). Like holeStones, it is kept
+	// current by applyMove, and anything else that writes to board must
+	// call rehash() afterwards.
+	uint64_t hash;
 private:
+	const GameConfig* config;
 	bool isP1Turn;
 };
 
+// Copying a State during search must be a plain memcpy
+static_assert(std::is_trivially_copyable<State>::value,
+		"State must be trivially copyable");
+
 std::ostream& operator<<(std::ostream& stream, const State& state);
+bool parseState(const GameConfig& config, const std::string& text,
+		State& state);
 
 #endif /* SRC_STATE_H_ */
@@ -0,0 +1,84 @@
+/*
+ * Tablebase.h
+ *
+ *  Created on: Mar 16, 2016
+ *      Author: derek
+ */
+
+#ifndef SRC_TABLEBASE_H_
+#define SRC_TABLEBASE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+struct GameConfig;
+struct State;
+
+// Most uncaptured stones a tablebase can cover
+constexpr int MAX_TABLEBASE_STONES = 63;
+
+/**
+ * Numbers every way of spreading up to maxStones stones over the holes of
+ * both players, so they can be stored in a flat array.
+ *
+ * Positions are grouped by how many stones are left, fewest first, and
+ * ranked within a group in lexicographic order of p1Holes() followed by
+ * p2Holes(). Whose turn it is isn't part of the index.
+ */
+class TablebaseIndex
+{
+public:
+	TablebaseIndex(int numHoles, int maxStones);
+	uint64_t layerSize(int stones) const;
+	uint64_t layerOffset(int stones) const;
+	uint64_t size() const;
+	int getMaxStones() const;
+	uint64_t rankOf(const State& state, int stones) const;
+	void setHoles(State& state, int stones, uint64_t rank) const;
+private:
+	int numHoles;
+	int maxStones;
+	std::vector<uint64_t> ways;    // [stones][holes]: ways to spread them
+	std::vector<uint64_t> offsets; // [stones]: index of the first position
+	uint64_t waysToSpread(int stones, int holes) const;
+};
+
+/**
+ * Perfect-play results for every position with at most maxStones stones
+ * left on the board, for one number of holes.
+ *
+ * Each entry is how many more stones P1 will capture than P2 from that
+ * position on, if both play perfectly. Play that goes round in circles
+ * forever without capturing anything counts as 0.
+ *
+ * Entries also say whether the game ends, if the player the lead favours
+ * ends it when it can and the other player goes round in circles when it
+ * can, both without giving up any of the lead. A draw by repetition, at
+ * the start or after some captures, doesn't end.
+ *
+ * The file is mapped read-only, so any number of search threads can probe
+ * it at once without locks.
+ */
+class Tablebase
+{
+public:
+	Tablebase();
+	Tablebase(const Tablebase&) = delete;
+	Tablebase& operator=(const Tablebase&) = delete;
+	~Tablebase();
+	bool open(const std::string& path, int numHoles);
+	bool probe(const State& state, int& p1Lead, bool& ends) const;
+	int getMaxStones() const;
+private:
+	void* mapping;
+	std::size_t mappingSize;
+	const int8_t* values;
+	std::unique_ptr<TablebaseIndex> index;
+};
+
+bool generateTablebase(const std::string& path, const GameConfig& config,
+		int maxStones, int numThreads);
+
+#endif /* SRC_TABLEBASE_H_ */
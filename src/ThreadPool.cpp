@@ -0,0 +1,92 @@
+/*
+ * ThreadPool.cpp
+ *
+ *  Created on: Mar 12, 2016
+ *      Author: derek
+ */
+
+#include "ThreadPool.h"
+#include <cassert>
+
+ThreadPool::ThreadPool(int numThreads)
+: workers{},
+  mutex{},
+  jobReady{},
+  jobDone{},
+  job{nullptr},
+  generation{0},
+  running{0},
+  stopping{false}
+{
+	assert(numThreads >= 1);
+	for (auto i = 1; i < numThreads; ++i)
+	{
+		workers.emplace_back(&ThreadPool::workerLoop, this, i);
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock{mutex};
+		stopping = true;
+	}
+	jobReady.notify_all();
+	for (auto& worker : workers)
+	{
+		worker.join();
+	}
+}
+
+int ThreadPool::size() const
+{
+	return static_cast<int>(workers.size()) + 1;
+}
+
+void ThreadPool::runOnAll(const std::function<void(int)>& job)
+{
+	{
+		std::lock_guard<std::mutex> lock{mutex};
+		assert(running == 0);
+		this->job = &job;
+		running = static_cast<int>(workers.size());
+		generation += 1;
+	}
+	jobReady.notify_all();
+
+	// The calling thread does its share instead of sitting idle
+	job(0);
+
+	std::unique_lock<std::mutex> lock{mutex};
+	jobDone.wait(lock, [this]{ return running == 0; });
+	this->job = nullptr;
+}
+
+void ThreadPool::workerLoop(int threadIndex)
+{
+	auto seen = 0u;
+	while (true)
+	{
+		const std::function<void(int)>* current = nullptr;
+		{
+			std::unique_lock<std::mutex> lock{mutex};
+			jobReady.wait(lock,
+					[&]{ return stopping || generation != seen; });
+			if (stopping)
+			{
+				return;
+			}
+			seen = generation;
+			current = job;
+		}
+
+		(*current)(threadIndex);
+
+		std::lock_guard<std::mutex> lock{mutex};
+		running -= 1;
+		if (running == 0)
+		{
+			jobDone.notify_one();
+		}
+	}
+}
@@ -0,0 +1,46 @@
+/*
+ * ThreadPool.h
+ *
+ *  Created on: Mar 12, 2016
+ *      Author: derek
+ */
+
+#ifndef SRC_THREADPOOL_H_
+#define SRC_THREADPOOL_H_
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * A fixed set of threads that run the same job together.
+ *
+ * runOnAll() hands job(threadIndex) to every worker, runs job(0) on the
+ * calling thread itself, and returns once they have all finished. The
+ * threads are started once and reused, so searches don't pay for thread
+ * creation every time they go parallel.
+ */
+class ThreadPool
+{
+public:
+	explicit ThreadPool(int numThreads);
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+	~ThreadPool();
+	int size() const;
+	void runOnAll(const std::function<void(int)>& job);
+private:
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable jobReady;
+	std::condition_variable jobDone;
+	const std::function<void(int)>* job;
+	unsigned generation;
+	int running;
+	bool stopping;
+	void workerLoop(int threadIndex);
+};
+
+#endif /* SRC_THREADPOOL_H_ */
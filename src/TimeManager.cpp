@@ -0,0 +1,64 @@
+/*
+ * TimeManager.cpp
+ *
+ *  Created on: Mar 15, 2016
+ *      Author: derek
+ */
+
+#include "TimeManager.h"
+#include "State.h"
+#include <algorithm>
+
+namespace
+{
+
+// Never plan on fewer moves than this, so a bad guess late in the game
+// doesn't spend the whole clock on one move.
+const int MIN_MOVES_TO_GO = 5;
+
+// Roughly how many stones leave the board per move a player makes
+const int STONES_PER_MOVE = 4;
+
+int playerIndex(const State& state)
+{
+	return state.getIsP1Turn() ? 0 : 1;
+}
+
+}
+
+TimeManager::TimeManager(long clockMs, long moveMs)
+: hasClock{clockMs > 0},
+  moveLimit{moveMs},
+  clocks{Milliseconds{clockMs}, Milliseconds{clockMs}}
+{
+}
+
+// How long the player to move in state should spend on this move
+TimeManager::Milliseconds TimeManager::budgetFor(const State& state) const
+{
+	if (!hasClock)
+	{
+		return moveLimit;
+	}
+
+	auto movesToGo = std::max(MIN_MOVES_TO_GO,
+			state.getUncaptured() / STONES_PER_MOVE);
+	auto budget = remaining(state) / movesToGo;
+	if (moveLimit.count() > 0)
+	{
+		budget = std::min(budget, moveLimit);
+	}
+	return std::max(budget, Milliseconds{1});
+}
+
+// Takes the time a move took off the clock of the player who made it
+void TimeManager::charge(const State& state, Milliseconds used)
+{
+	auto& clock = clocks[playerIndex(state)];
+	clock = std::max(clock - used, Milliseconds{0});
+}
+
+TimeManager::Milliseconds TimeManager::remaining(const State& state) const
+{
+	return clocks[playerIndex(state)];
+}
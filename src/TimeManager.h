@@ -0,0 +1,38 @@
+/*
+ * TimeManager.h
+ *
+ *  Created on: Mar 15, 2016
+ *      Author: derek
+ */
+
+#ifndef SRC_TIMEMANAGER_H_
+#define SRC_TIMEMANAGER_H_
+
+#include <chrono>
+class State;
+
+/**
+ * Shares out thinking time for the AI players.
+ *
+ * Each player has a clock of clockMs milliseconds for the whole game, and
+ * each move gets a slice of what is left, based on a guess at how many
+ * more moves that player will have to make. moveMs, if set, caps every
+ * move's budget, and with no clock it is simply the budget for every move.
+ */
+class TimeManager
+{
+public:
+	using Clock = std::chrono::steady_clock;
+	using Milliseconds = std::chrono::milliseconds;
+
+	TimeManager(long clockMs, long moveMs);
+	Milliseconds budgetFor(const State& state) const;
+	void charge(const State& state, Milliseconds used);
+	Milliseconds remaining(const State& state) const;
+private:
+	bool hasClock;
+	Milliseconds moveLimit;
+	Milliseconds clocks[2]; // time left for P1 and P2
+};
+
+#endif /* SRC_TIMEMANAGER_H_ */
@@ -0,0 +1,115 @@
+/*
+ * TranspositionTable.cpp
+ *
+ *  Created on: Mar 10, 2016
+ *      Author: derek
+ */
+
+#include "TranspositionTable.h"
+#include "Move.h"
+#include <cassert>
+
+namespace
+{
+
+// Layout of Slot::data, low bits first:
+//   value (32) | depth (8) | bound (8) | bestMove (8) | generation (8)
+uint64_t pack(const TableEntry& entry, uint8_t generation)
+{
+	return static_cast<uint32_t>(entry.value)
+			| static_cast<uint64_t>(entry.depth) << 32
+			| static_cast<uint64_t>(entry.bound) << 40
+			| static_cast<uint64_t>(entry.bestMove) << 48
+			| static_cast<uint64_t>(generation) << 56;
+}
+
+TableEntry unpack(uint64_t data)
+{
+	return TableEntry{static_cast<int>(static_cast<uint32_t>(data)),
+			static_cast<uint8_t>(data >> 32),
+			static_cast<Bound>(static_cast<uint8_t>(data >> 40)),
+			static_cast<uint8_t>(data >> 48)};
+}
+
+uint8_t generationOf(uint64_t data)
+{
+	return static_cast<uint8_t>(data >> 56);
+}
+
+}
+
+TranspositionTable::TranspositionTable(std::size_t megabytes,
+		ReplacementPolicy policy)
+: slots{nullptr},
+  indexBits{0},
+  generation{1},
+  policy{policy}
+{
+	// Round down to a power of two so the index is just the top hash bits
+	assert(megabytes > 0);
+	auto numSlots = megabytes * 1024 * 1024 / sizeof(Slot);
+	while ((std::size_t{2} << indexBits) <= numSlots)
+	{
+		++indexBits;
+	}
+	slots.reset(new Slot[std::size_t{1} << indexBits]);
+	clear();
+}
+
+void TranspositionTable::clear()
+{
+	for (std::size_t i = 0; i < (std::size_t{1} << indexBits); ++i)
+	{
+		slots[i].check.store(0, std::memory_order_relaxed);
+		slots[i].data.store(0, std::memory_order_relaxed);
+	}
+}
+
+void TranspositionTable::newSearch()
+{
+	// Generation 0 marks empty slots, so wipe the table when we wrap
+	generation += 1;
+	if (generation == 0)
+	{
+		clear();
+		generation = 1;
+	}
+}
+
+TranspositionTable::Slot& TranspositionTable::slotFor(uint64_t key) const
+{
+	return slots[indexBits == 0 ? 0 : key >> (64 - indexBits)];
+}
+
+bool TranspositionTable::probe(uint64_t key, TableEntry& entry) const
+{
+	auto& slot = slotFor(key);
+	auto data = slot.data.load(std::memory_order_relaxed);
+	auto check = slot.check.load(std::memory_order_relaxed);
+	if ((check ^ data) != key || generationOf(data) != generation)
+	{
+		return false;
+	}
+	entry = unpack(data);
+	return true;
+}
+
+void TranspositionTable::store(uint64_t key, int value, uint8_t depth,
+		Bound bound, uint8_t bestMove)
+{
+	auto& slot = slotFor(key);
+	if (policy == ReplacementPolicy::DEPTH)
+	{
+		auto old = slot.data.load(std::memory_order_relaxed);
+		auto oldKey = slot.check.load(std::memory_order_relaxed) ^ old;
+		if (generationOf(old) == generation && oldKey != key
+				&& unpack(old).depth > depth)
+		{
+			return;
+		}
+	}
+
+	auto data = pack(TableEntry{value, depth, bound, bestMove}, generation);
+	slot.check.store(key ^ data, std::memory_order_relaxed);
+	slot.data.store(data, std::memory_order_relaxed);
+}
@@ -0,0 +1,72 @@
+/*
+ * TranspositionTable.h
+ *
+ *  Created on: Mar 10, 2016
+ *      Author: derek
+ */
+
+#ifndef SRC_TRANSPOSITIONTABLE_H_
+#define SRC_TRANSPOSITIONTABLE_H_
+
+#include "Move.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+enum class Bound : uint8_t
+{
+	EXACT, // value is the minimax value of the position
+	LOWER, // search failed high, true value >= value
+	UPPER  // search failed low, true value <= value
+};
+
+enum class ReplacementPolicy : uint8_t
+{
+	ALWAYS, // newest result always wins the slot
+	DEPTH   // keep the deeper result unless the old one is from a past search
+};
+
+struct TableEntry
+{
+	int value;
+	uint8_t depth;
+	Bound bound;
+	uint8_t bestMove; // see encodeMove()
+};
+
+/**
+ * Fixed-size hash table of search results, keyed by State::getHash().
+ *
+ * Slots are written without locks. Each slot stores key ^ data next to the
+ * data, so a probe that races with a store sees a key mismatch rather than
+ * a torn entry.
+ *
+ * Values are relative to whoever was maximizing when they were stored, so
+ * newSearch() must be called whenever a new root is searched. Entries from
+ * previous searches then read as misses.
+ */
+class TranspositionTable
+{
+public:
+	explicit TranspositionTable(std::size_t megabytes,
+			ReplacementPolicy policy);
+	void newSearch();
+	void clear();
+	bool probe(uint64_t key, TableEntry& entry) const;
+	void store(uint64_t key, int value, uint8_t depth, Bound bound,
+			uint8_t bestMove);
+private:
+	struct Slot
+	{
+		std::atomic<uint64_t> check;
+		std::atomic<uint64_t> data;
+	};
+	std::unique_ptr<Slot[]> slots;
+	uint8_t indexBits;
+	uint8_t generation;
+	ReplacementPolicy policy;
+	Slot& slotFor(uint64_t key) const;
+};
+
+#endif /* SRC_TRANSPOSITIONTABLE_H_ */
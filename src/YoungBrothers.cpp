@@ -0,0 +1,485 @@
+/*
+ * YoungBrothers.cpp
+ *
+ *  Created on: Mar 13, 2016
+ *      Author: derek
+ */
+
+/**
+ * Work-stealing parallel alpha-beta using the Young Brothers Wait concept.
+ *
+ * Every thread runs the usual depth-first fringe loop. Once a node's first
+ * child (its "eldest brother") has been fully searched, the node becomes a
+ * split point: it goes on the back of its owner's deque, and idle threads
+ * steal its remaining children from the front of other threads' deques, so
+ * they take the shallowest, and therefore biggest, pieces of work.
+ *
+ * A thief searches the stolen child with its own fringe and then merges the
+ * result into the split node under the split point's lock. The owner keeps
+ * expanding the split node's children too. Once they are all taken, it
+ * helps the thieves, stealing only work from below the split node, until
+ * they finish; then it reports the node to its parent.
+ *
+ * Bounds reach every thread in two ways. Each thread regularly copies the
+ * windows of the nodes above it down its own fringe: the split node it
+ * stole from, if any, and its own split nodes, which its thieves update.
+ * So a better alpha or beta found by a sibling tightens the search of
+ * whoever is below that node, owner or thief. And if a sibling causes a
+ * cutoff, the split point is aborted; everyone below it drops their work,
+ * aborting their own split points on the way out.
+ */
+#include "YoungBrothers.h"
+#include "Node.h"
+#include "NodeStack.h"
+#include "SearchThread.h"
+#include "Settings.h"
+#include "ThreadPool.h"
+#include <atomic>
+#include <cassert>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+// Nodes with fewer turns left than this are not worth sharing
+const uint8_t MIN_SPLIT_DEPTH = 2;
+
+// Fringe loop iterations between copies of the split nodes' windows
+const int REFRESH_INTERVAL = 32;
+
+// No fringe level at all
+const std::size_t NO_LEVEL = static_cast<std::size_t>(-1);
+
+template <typename Evaluator>
+struct SplitPoint
+{
+	Node<Evaluator>* node; // lives in the owner's fringe; null while unused
+	std::mutex mutex;
+	std::atomic<int> helpers;
+	std::atomic<bool> aborted;
+};
+
+template <typename Evaluator>
+struct Worker
+{
+	// Guards splitPoints. Always taken before any SplitPoint::mutex.
+	std::mutex mutex;
+	std::deque<SplitPoint<Evaluator>*> splitPoints;
+
+	// One split point per fringe level. A thread that steals while it
+	// waits for its own thieves searches on top of its fringe, so the
+	// levels of its searches never overlap.
+	SplitPoint<Evaluator> levels[MAX_SEARCH_DEPTH + 1];
+	bool active[MAX_SEARCH_DEPTH + 1];
+	int nodesExpanded;
+	int index; // in the thread pool
+
+	// Made for each search. Level 0 is the root, which only thread 0
+	// searches, and level L > 0 is fringe[L - 1]; stolen children are
+	// pushed on top like any other.
+	std::unique_ptr<NodeStack<Evaluator> > fringe;
+};
+
+template <typename Evaluator>
+class YoungBrothersSearch
+{
+public:
+	explicit YoungBrothersSearch(SearchContext& context);
+	SearchResult run(const State& state, uint8_t depth);
+private:
+	using SearchNode = Node<Evaluator>;
+	using SearchWorker = Worker<Evaluator>;
+	using Split = SplitPoint<Evaluator>;
+	SearchContext& context;
+	std::vector<std::unique_ptr<SearchWorker> > workers;
+	std::atomic<bool> done;
+	bool searchSubtree(SearchWorker& self, SearchNode& base, Split* within);
+	bool trySteal(SearchWorker& self, const SearchNode* below);
+	void publish(SearchWorker& self, std::size_t level, SearchNode& node);
+	void retire(SearchWorker& self, std::size_t level);
+	void abandon(SearchWorker& self, std::size_t level);
+	std::size_t abortedLevel(const SearchWorker& self) const;
+	void refreshWindows(SearchWorker& self, Split* within, SearchNode& base,
+			std::size_t baseLevel);
+};
+
+template <typename Evaluator>
+YoungBrothersSearch<Evaluator>::YoungBrothersSearch(SearchContext& context)
+: context{context},
+  workers{},
+  done{false}
+{
+	for (auto i = 0; i < context.threadPool->size(); ++i)
+	{
+		workers.emplace_back(std::make_unique<SearchWorker>());
+		for (auto& active : workers.back()->active)
+		{
+			active = false;
+		}
+		for (auto& level : workers.back()->levels)
+		{
+			level.node = nullptr;
+			level.helpers = 0;
+			level.aborted = false;
+		}
+		workers.back()->nodesExpanded = 0;
+		workers.back()->index = i;
+	}
+}
+
+template <typename Evaluator>
+SearchResult YoungBrothersSearch<Evaluator>::run(const State& state,
+		uint8_t depth)
+{
+	reserveSearchThreads(context, workers.size());
+	for (auto& worker : workers)
+	{
+		auto& thread = *context.threads[worker->index];
+		thread.stats = SearchStats{};
+		worker->fringe = std::make_unique<NodeStack<Evaluator> >(context,
+				thread, state, depth);
+	}
+	auto root = SearchNode{context, state, depth, true};
+	std::atomic<bool> complete{false};
+
+	context.threadPool->runOnAll([&](int threadIndex)
+	{
+		auto& self = *workers[threadIndex];
+		if (threadIndex == 0)
+		{
+			complete = searchSubtree(self, root, nullptr);
+			done = true;
+		}
+		else
+		{
+			while (!done)
+			{
+				if (!trySteal(self, nullptr))
+				{
+					std::this_thread::yield();
+				}
+			}
+		}
+	});
+
+	auto nodesExpanded = 0;
+	for (auto& worker : workers)
+	{
+		nodesExpanded += worker->nodesExpanded;
+	}
+	auto stats = SearchStats{};
+	for (std::size_t i = 0; i < workers.size(); ++i)
+	{
+		stats += context.threads[i]->stats;
+	}
+	if (!complete)
+	{
+		auto partial = root.hasBestMove() ? root.getBestMove()
+				: MoveSequence{};
+		return SearchResult{partial, root.getValue(),
+				nodesExpanded, stats, false, 0};
+	}
+	root.storeInTable();
+	return SearchResult{root.getBestMove(), root.getValue(),
+			nodesExpanded, stats, true, 0};
+}
+
+// Makes node, which sits at the given level of self's fringe, available
+// for other threads to steal children from.
+template <typename Evaluator>
+void YoungBrothersSearch<Evaluator>::publish(SearchWorker& self,
+		std::size_t level, SearchNode& node)
+{
+	auto& split = self.levels[level];
+	std::lock_guard<std::mutex> listLock{self.mutex};
+	std::lock_guard<std::mutex> splitLock{split.mutex};
+	split.node = &node;
+	split.helpers = 0;
+	split.aborted = false;
+	self.splitPoints.push_back(&split);
+	self.active[level] = true;
+}
+
+// Waits for every thief of the split point at level to finish, then takes
+// it off self's deque so its node can be popped. Meanwhile it helps them
+// with work from below the split node, unless the split point was aborted.
+template <typename Evaluator>
+void YoungBrothersSearch<Evaluator>::retire(SearchWorker& self,
+		std::size_t level)
+{
+	auto& split = self.levels[level];
+	while (split.helpers > 0)
+	{
+		if (split.aborted || !trySteal(self, split.node))
+		{
+			std::this_thread::yield();
+		}
+	}
+
+	std::lock_guard<std::mutex> listLock{self.mutex};
+	std::lock_guard<std::mutex> splitLock{split.mutex};
+	assert(self.splitPoints.back() == &split);
+	self.splitPoints.pop_back();
+	split.node = nullptr;
+	self.active[level] = false;
+}
+
+// Pops the nodes above level off self's fringe without reporting them,
+// aborting their split points and waiting for those thieves first
+template <typename Evaluator>
+void YoungBrothersSearch<Evaluator>::abandon(SearchWorker& self,
+		std::size_t level)
+{
+	auto& fringe = *self.fringe;
+	while (fringe.size() > level)
+	{
+		const auto top = fringe.size();
+		if (self.active[top])
+		{
+			self.levels[top].aborted = true;
+			retire(self, top);
+		}
+		fringe.pop();
+	}
+}
+
+// The shallowest of self's split points that a thief has aborted by
+// cutting its node off, or NO_LEVEL
+template <typename Evaluator>
+std::size_t YoungBrothersSearch<Evaluator>::abortedLevel(
+		const SearchWorker& self) const
+{
+	for (std::size_t level = 0; level <= self.fringe->size(); ++level)
+	{
+		if (self.active[level] && self.levels[level].aborted)
+		{
+			return level;
+		}
+	}
+	return NO_LEVEL;
+}
+
+// Copies windows down into every node we're searching: first that of the
+// split node base was stolen from, if any, then that of each node on our
+// fringe in turn. Our own split nodes are narrowed by their thieves, so
+// this is how the owner hears of it.
+template <typename Evaluator>
+void YoungBrothersSearch<Evaluator>::refreshWindows(SearchWorker& self,
+		Split* within, SearchNode& base, std::size_t baseLevel)
+{
+	auto& fringe = *self.fringe;
+	auto known = within != nullptr;
+	auto alpha = 0;
+	auto beta = 0;
+	if (within)
+	{
+		std::lock_guard<std::mutex> lock{within->mutex};
+		alpha = within->node->getAlpha();
+		beta = within->node->getBeta();
+	}
+
+	for (auto level = baseLevel; level <= fringe.size(); ++level)
+	{
+		auto& node = level == baseLevel ? base : fringe[level - 1];
+		auto lock = std::unique_lock<std::mutex>{self.levels[level].mutex,
+				std::defer_lock};
+		if (self.active[level])
+		{
+			lock.lock();
+		}
+		if (known)
+		{
+			node.narrowWindow(alpha, beta);
+		}
+		alpha = node.getAlpha();
+		beta = node.getBeta();
+		known = true;
+	}
+}
+
+/**
+ * The ordinary fringe loop below base, plus split point bookkeeping. base
+ * is the root or the top of self's fringe, and the loop pushes its nodes
+ * above base, whose frames never move while the children point back to
+ * them.
+ *
+ * within is the split point base was stolen from, or null for the root.
+ * Returns false if that split point, or one of ours further down the
+ * fringe, was aborted, or the search ran out of time; base then holds no
+ * meaningful result.
+ */
+template <typename Evaluator>
+bool YoungBrothersSearch<Evaluator>::searchSubtree(SearchWorker& self,
+		SearchNode& base, Split* within)
+{
+	auto& fringe = *self.fringe;
+	const auto baseLevel = fringe.size();
+	auto untilRefresh = REFRESH_INTERVAL;
+	while (true)
+	{
+		auto aborted = NO_LEVEL;
+		if (--untilRefresh == 0)
+		{
+			untilRefresh = REFRESH_INTERVAL;
+			refreshWindows(self, within, base, baseLevel);
+			aborted = abortedLevel(self);
+		}
+
+		if ((within && within->aborted) || aborted < baseLevel
+				|| searchStopped(context))
+		{
+			// Drop everything, making sure our own thieves are gone first
+			abandon(self, baseLevel);
+			if (self.active[baseLevel])
+			{
+				self.levels[baseLevel].aborted = true;
+				retire(self, baseLevel);
+			}
+			return false;
+		}
+		if (aborted != NO_LEVEL && aborted < fringe.size())
+		{
+			// A thief cut off one of our split nodes, so whatever we're
+			// searching above it no longer matters
+			abandon(self, aborted);
+		}
+
+		auto level = fringe.size();
+		auto& node = level == baseLevel ? base : fringe.top();
+		auto expanded = false;
+		if (self.active[level])
+		{
+			std::lock_guard<std::mutex> lock{self.levels[level].mutex};
+			if (node.hasNextNode())
+			{
+				fringe.push(node);
+				expanded = true;
+			}
+		}
+		else if (node.hasNextNode())
+		{
+			fringe.push(node);
+			expanded = true;
+		}
+
+		if (expanded)
+		{
+			self.nodesExpanded += 1;
+			if ((self.nodesExpanded & CLOCK_CHECK_MASK) == 0)
+			{
+				checkSearchClock(context);
+			}
+			continue;
+		}
+
+		// No more children to expand here, but thieves may still be busy
+		// with some of them.
+		if (self.active[level])
+		{
+			retire(self, level);
+		}
+
+		if (level == baseLevel)
+		{
+			return true;
+		}
+
+		// Report to the parent, which is the one others may be updating
+		auto& parentSplit = self.levels[level - 1];
+		if (self.active[level - 1])
+		{
+			std::lock_guard<std::mutex> lock{parentSplit.mutex};
+			node.updateParent();
+			if (parentSplit.node->isCutoff())
+			{
+				parentSplit.aborted = true;
+			}
+		}
+		else
+		{
+			node.updateParent();
+		}
+		fringe.pop();
+
+		// The parent's eldest brother is done, so its younger brothers
+		// can now be searched in parallel.
+		auto& parent = fringe.size() == baseLevel ? base : fringe.top();
+		if (!self.active[level - 1] && parent.getDepth() >= MIN_SPLIT_DEPTH
+				&& parent.hasNextNode())
+		{
+			publish(self, level - 1, parent);
+		}
+	}
+}
+
+// Looks through the other threads' deques, oldest split points first, for
+// a child to search, and searches it on top of self's fringe. If below is
+// set, only split nodes under it will do, so a thread waiting for its own
+// thieves only takes on work that they are waiting for too. Returns false
+// if there was nothing to steal.
+template <typename Evaluator>
+bool YoungBrothersSearch<Evaluator>::trySteal(SearchWorker& self,
+		const SearchNode* below)
+{
+	auto& fringe = *self.fringe;
+	for (std::size_t offset = 1; offset < workers.size(); ++offset)
+	{
+		auto& victim = *workers[(self.index + offset) % workers.size()];
+		Split* split = nullptr;
+		{
+			std::lock_guard<std::mutex> listLock{victim.mutex};
+			for (auto candidate : victim.splitPoints)
+			{
+				std::lock_guard<std::mutex> splitLock{candidate->mutex};
+				if (!candidate->aborted
+						&& (!below || candidate->node->isBelow(*below))
+						&& candidate->node->hasNextNode())
+				{
+					fringe.push(*candidate->node);
+					candidate->helpers += 1;
+					split = candidate;
+					break;
+				}
+			}
+		}
+		if (!split)
+		{
+			continue;
+		}
+
+		self.nodesExpanded += 1;
+		auto& child = fringe.top();
+		if (searchSubtree(self, child, split))
+		{
+			std::lock_guard<std::mutex> lock{split->mutex};
+			child.updateParent();
+			if (split->node->isCutoff())
+			{
+				split->aborted = true;
+			}
+		}
+		fringe.pop();
+		split->helpers -= 1;
+		return true;
+	}
+	return false;
+}
+
+}
+
+template <typename Evaluator>
+SearchResult searchYoungBrothersWait(SearchContext& context,
+		const State& state, uint8_t depth)
+{
+	YoungBrothersSearch<Evaluator> search{context};
+	return search.run(state, depth);
+}
+
+template SearchResult searchYoungBrothersWait<Heuristic1Evaluator>(
+		SearchContext& context, const State& state, uint8_t depth);
+template SearchResult searchYoungBrothersWait<Heuristic2Evaluator>(
+		SearchContext& context, const State& state, uint8_t depth);
@@ -0,0 +1,19 @@
+/*
+ * YoungBrothers.h
+ *
+ *  Created on: Mar 13, 2016
+ *      Author: derek
+ */
+
+#ifndef SRC_YOUNGBROTHERS_H_
+#define SRC_YOUNGBROTHERS_H_
+
+#include "Search.h"
+#include "State.h"
+#include <cstdint>
+
+template <typename Evaluator>
+SearchResult searchYoungBrothersWait(SearchContext& context,
+		const State& state, uint8_t depth);
+
+#endif /* SRC_YOUNGBROTHERS_H_ */
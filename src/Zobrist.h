@@ -0,0 +1,54 @@
+/*
+ * Zobrist.h
+ *
+ *  Created on: Mar 9, 2016
+ *      Author: derek
+ */
+
+#ifndef SRC_ZOBRIST_H_
+#define SRC_ZOBRIST_H_
+
+#include "State.h"
+#include <cstdint>
+
+/**
+ * Random keys for hashing a State, generated at compile time.
+ *
+ * Unlike chess pieces, mancala squares hold counts, so a State hashes to
+ * the sum of key[square] * stones over all squares. Moving one stone is
+ * then a single add and a subtract, which keeps the hash cheap to update
+ * while sowing. The low bits of such a sum are poorly mixed, so tables
+ * should index with the high bits.
+ */
+struct ZobristKeys
+{
+	constexpr ZobristKeys()
+	: square{},
+	  p2ToMove{0}
+	{
+		auto seed = uint64_t{0x2545F4914F6CDD1D};
+		for (auto i = 0; i < BOARD_SIZE; ++i)
+		{
+			square[i] = next(seed);
+		}
+		p2ToMove = next(seed);
+	}
+
+	uint64_t square[BOARD_SIZE];
+	uint64_t p2ToMove;
+
+private:
+	// splitmix64
+	static constexpr uint64_t next(uint64_t& seed)
+	{
+		seed += 0x9E3779B97F4A7C15;
+		auto z = seed;
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EB;
+		return z ^ (z >> 31);
+	}
+};
+
+constexpr ZobristKeys ZOBRIST{};
+
+#endif /* SRC_ZOBRIST_H_ */
@@ -1,46 +1,284 @@
 #include <iostream>
+#include <fstream>
 #include <cstring>
 #include <sstream>
 #include <string>
 #include <cstddef>
 #include <vector>
-#include <queue>
 #include <stack>
 #include <cassert>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+#include <utility>
+#include <thread>
+#include "Analysis.h"
 #include "Settings.h"
 #include "State.h"
 #include "Move.h"
 #include "HoleIterator.h"
 #include "MoveIterator.h"
+#include "MonteCarlo.h"
 #include "Node.h"
+#include "OpeningBook.h"
+#include "Perft.h"
+#include "PositionFile.h"
+#include "SelfPlay.h"
+#include "Search.h"
+#include "Tablebase.h"
+#include "ThreadPool.h"
+#include "TimeManager.h"
+#include "TranspositionTable.h"
 using namespace std;
 
 void tests();
 void usage();
+bool parseOption(Settings& settings, const string& option);
+int tablebaseCommand(Settings& settings, int argc, char** argv);
+int bookCommand(Settings& settings, int argc, char** argv);
+int perftCommand(Settings& settings, int argc, char** argv);
+int selfPlayCommand(Settings& settings, int argc, char** argv);
+int analyzeCommand(Settings& settings, int argc, char** argv);
+void createSearchTables(Settings& settings);
+bool openSearchFiles(Settings& settings);
 State nextHumanMove(const State& currentState);
-State nextAiMove(const State& currentState);
+State nextAiMove(Settings& settings, const State& currentState);
+void printSearchStats(int depth, const SearchResult& result, double seconds);
+void writeSearchStats(ostream& stream, const State& state, int depth,
+		const SearchResult& result, double seconds);
+State nextMctsMove(Settings& settings, const State& currentState);
 
 void usage()
 {
-	cerr << "Usage: mancala [stones] [holes] [depth] [prune] [p1] [p2] [enable-id]" << endl
+	cerr << "Usage: mancala [stones] [holes] [depth] [prune] [p1] [p2] [enable-id] [options]" << endl
+		 << "   or:  mancala tablebase [holes] [max-stones] [file] [threads=N]" << endl
+		 << "   or:  mancala book [turns] [depth] [file] [options]" << endl
+		 << "   or:  mancala perft [stones] [holes] [depth] [options]" << endl
+		 << "   or:  mancala perft check" << endl
+		 << "   or:  mancala selfplay [stones] [holes] [depth] [games] [file] [options]" << endl
+		 << "   or:  mancala analyze [stones] [holes] [depth] [file] [options]" << endl
 		 << "   where stones in range [2, 6] " << endl
 	     <<	"         and holes in range [stones-1, 2*(stones-1)]" << endl
-		 << "         and depth in range [1,5]" << endl
+		 << "         and depth in range [1," << MAX_SEARCH_DEPTH << "]" << endl
 		 << "         and prune in [true, false]" << endl
-		 << "         and p1 in [human, ai-h1, ai-h2]" << endl
-		 << "         and p2 in [human, ai-h1, ai-h2]" << endl
-		 << "         and enable-id in [true, false]" << endl;
+		 << "         and p1 in [human, ai-h1, ai-h2, ai-mcts]" << endl
+		 << "         and p2 in [human, ai-h1, ai-h2, ai-mcts]" << endl
+		 << "         and enable-id in [true, false]" << endl
+		 << "   options are any of" << endl
+		 << "         tt-mb=N (transposition table megabytes, 0 disables)" << endl
+		 << "         tt-replace=[depth, always]" << endl
+		 << "         threads=N (search on N threads; the move chosen" << endl
+		 << "             may differ from one thread's, but not its value)" << endl
+		 << "         parallel=[root, ybw] (split only at the root, or" << endl
+		 << "             anywhere with work-stealing Young Brothers Wait)" << endl
+		 << "         ordering=[none, killer-history] (try moves in the" << endl
+		 << "             order generated, or best-looking first)" << endl
+		 << "         search=[alpha-beta, pvs, mtdf] (minimax with" << endl
+		 << "             alpha-beta pruning, principal variation search" << endl
+		 << "             with aspiration windows, or MTD(f), which" << endl
+		 << "             needs tt-mb; pvs and mtdf use one thread)" << endl
+		 << "         clock-ms=N (each AI gets N ms for the whole game and" << endl
+		 << "             searches as deep as time allows; depth is ignored)" << endl
+		 << "         move-ms=N (at most N ms per AI move, likewise)" << endl
+		 << "         playouts=N (per ai-mcts search, which ignores depth," << endl
+		 << "             prune and enable-id; default 20000, and" << endl
+		 << "             clock-ms and move-ms replace it)" << endl
+		 << "         tablebase=FILE (score solved endgames exactly)" << endl
+		 << "         book=FILE (play the opening from a book, if it was" << endl
+		 << "             searched with the AI's heuristic and depth)" << endl
+		 << "         stats=FILE (write each AI search iteration's" << endl
+		 << "             statistics to FILE as a line of JSON)" << endl
+		 << "   book also takes" << endl
+		 << "         only=SxH (just S stones and H holes; repeatable," << endl
+		 << "             default is every board size)" << endl
+		 << "         heuristic=[h1, h2] (default h2)" << endl
+		 << "   perft also takes" << endl
+		 << "         unit=[turn, move] (count whole turns, or each sowing)" << endl
+		 << "         bulk=[true, false] (count the last ply without" << endl
+		 << "             making its moves; default true)" << endl
+		 << "         from=STATE (e.g. *0/4,4,4/4,4,4/0, instead of the" << endl
+		 << "             starting position)" << endl
+		 << "   selfplay also takes" << endl
+		 << "         p1=[h1, h2], p2=[h1, h2] (heuristics; default h1, h2)" << endl
+		 << "         random=N (opening turns to play at random, up to" << endl
+		 << "             255; default 2)" << endl
+		 << "         seed=N (for the random turns; default 1)" << endl
+		 << "         workers=N (games played at once; default one per core)" << endl
+		 << "   analyze reads positions like *2/0,0,6,6/4,4,5,5/0, one per" << endl
+		 << "   line, from file (- for stdin), or a position file written" << endl
+		 << "   by out=, and writes each position with its best turn," << endl
+		 << "   value for the player to move, depth and nodes, in the same" << endl
+		 << "   order; move-ms=N deepens each position for N ms instead," << endl
+		 << "   and it also takes" << endl
+		 << "         heuristic=[h1, h2] (default h2)" << endl
+		 << "         out=FILE (also write the positions, scores and best" << endl
+		 << "             moves to FILE in binary)" << endl
+		 << "         workers=N (positions searched at once; default one" << endl
+		 << "             per core)" << endl;
+}
+
+// Handles the optional name=value settings that may follow the positional
+// arguments. Returns false if the option is not recognized or invalid.
+bool parseOption(Settings& settings, const string& option)
+{
+	auto split = option.find('=');
+	if (split == string::npos)
+	{
+		return false;
+	}
+	auto name = option.substr(0, split);
+	auto value = option.substr(split + 1);
+
+	if (name == "tt-mb")
+	{
+		auto megabytes = -1;
+		stringstream{value} >> megabytes;
+		if (megabytes < 0)
+		{
+			return false;
+		}
+		settings.tableMegabytes = megabytes;
+		return true;
+	}
+	else if (name == "clock-ms" || name == "move-ms")
+	{
+		auto milliseconds = -1L;
+		stringstream{value} >> milliseconds;
+		if (milliseconds <= 0)
+		{
+			return false;
+		}
+		(name == "clock-ms" ? settings.clockMilliseconds
+				: settings.moveMilliseconds) = milliseconds;
+		return true;
+	}
+	else if (name == "playouts")
+	{
+		auto playouts = -1;
+		stringstream{value} >> playouts;
+		if (playouts < 1)
+		{
+			return false;
+		}
+		settings.playouts = playouts;
+		return true;
+	}
+	else if (name == "book")
+	{
+		settings.bookPath = value;
+		return !value.empty();
+	}
+	else if (name == "stats")
+	{
+		settings.statsPath = value;
+		return !value.empty();
+	}
+	else if (name == "tablebase")
+	{
+		settings.tablebasePath = value;
+		return !value.empty();
+	}
+	else if (name == "threads")
+	{
+		auto threads = -1;
+		stringstream{value} >> threads;
+		if (threads < 1)
+		{
+			return false;
+		}
+		settings.numThreads = threads;
+		return true;
+	}
+	else if (name == "parallel")
+	{
+		if (value == "root")
+		{
+			settings.search.workStealing = false;
+			return true;
+		}
+		else if (value == "ybw")
+		{
+			settings.search.workStealing = true;
+			return true;
+		}
+	}
+	else if (name == "ordering")
+	{
+		if (value == "none")
+		{
+			settings.search.moveOrdering = Ordering::NATURAL;
+			return true;
+		}
+		else if (value == "killer-history")
+		{
+			settings.search.moveOrdering = Ordering::KILLER_HISTORY;
+			return true;
+		}
+	}
+	else if (name == "search")
+	{
+		if (value == "alpha-beta")
+		{
+			settings.search.algorithm = Algorithm::ALPHA_BETA;
+			return true;
+		}
+		else if (value == "pvs")
+		{
+			settings.search.algorithm = Algorithm::PVS;
+			return true;
+		}
+		else if (value == "mtdf")
+		{
+			settings.search.algorithm = Algorithm::MTDF;
+			return true;
+		}
+	}
+	else if (name == "tt-replace")
+	{
+		if (value == "depth")
+		{
+			settings.tableReplacement = ReplacementPolicy::DEPTH;
+			return true;
+		}
+		else if (value == "always")
+		{
+			settings.tableReplacement = ReplacementPolicy::ALWAYS;
+			return true;
+		}
+	}
+	return false;
 }
 
 int main(int argc, char** argv)
 {
-	initializeGlobals();
+	Settings settings;
 
 	// Run some sanity tests
 	tests();
 
+	if (argc > 1 && strcmp(argv[1], "tablebase") == 0)
+	{
+		return tablebaseCommand(settings, argc, argv);
+	}
+	if (argc > 1 && strcmp(argv[1], "book") == 0)
+	{
+		return bookCommand(settings, argc, argv);
+	}
+	if (argc > 1 && strcmp(argv[1], "perft") == 0)
+	{
+		return perftCommand(settings, argc, argv);
+	}
+	if (argc > 1 && strcmp(argv[1], "selfplay") == 0)
+	{
+		return selfPlayCommand(settings, argc, argv);
+	}
+	if (argc > 1 && strcmp(argv[1], "analyze") == 0)
+	{
+		return analyzeCommand(settings, argc, argv);
+	}
+
 	// Check number of parameters
-	if (argc != 8)
+	if (argc < 8)
 	{
 		usage();
 		return 1;
@@ -49,12 +287,11 @@ int main(int argc, char** argv)
 	// Get number of stones
 	auto stones = -1;
 	stringstream{argv[1]} >> stones;
-	if (stones < 2 || stones > 6)
+	if (stones < 2 || stones > MAX_STONES)
 	{
 		usage();
 		return 1;
 	}
-	globalState().numStones = stones;
 
 	// Get number of holes
 	auto holes = -1;
@@ -64,26 +301,26 @@ int main(int argc, char** argv)
 		usage();
 		return 1;
 	}
-	globalState().numHoles = holes;
+	settings.game = make_unique<GameConfig>(stones, holes);
 
 	// Get search depth
 	auto depth = -1;
 	stringstream{argv[3]} >> depth;
-	if (depth < 1 || depth > 5)
+	if (depth < 1 || depth > MAX_SEARCH_DEPTH)
 	{
 		usage();
 		return 1;
 	}
-	globalState().searchDepth = depth;
+	settings.searchDepth = depth;
 
 	// Get whether we should apply alpha-beta pruning
 	if (strncmp("true", argv[4], 4) == 0)
 	{
-		globalState().prune = true;
+		settings.search.prune = true;
 	}
 	else if (strncmp("false", argv[4], 5) == 0)
 	{
-		globalState().prune = false;
+		settings.search.prune = false;
 	}
 	else
 	{
@@ -94,20 +331,24 @@ int main(int argc, char** argv)
 	// Get P1 settings
 	if (strncmp("human", argv[5], 5) == 0)
 	{
-		globalState().p1Heuristic = nullptr;
-		globalState().p1NextMoveFn = nextHumanMove;
+		settings.p1NextMoveFn = nextHumanMove;
 	}
 	else if (strncmp("ai-h1", argv[5], 5) == 0)
 	{
-		globalState().p1Heuristic = [](const State& state)
-				{ return calculateHeuristic1(state, true); };
-		globalState().p1NextMoveFn = nextAiMove;
+		settings.p1Heuristic = Heuristic::H1;
+		settings.p1NextMoveFn = [&](const State& state)
+				{ return nextAiMove(settings, state); };
 	}
 	else if (strncmp("ai-h2", argv[5], 5) == 0)
 	{
-		globalState().p1Heuristic = [](const State& state)
-				{ return calculateHeuristic2(state, true); };
-		globalState().p1NextMoveFn = nextAiMove;
+		settings.p1Heuristic = Heuristic::H2;
+		settings.p1NextMoveFn = [&](const State& state)
+				{ return nextAiMove(settings, state); };
+	}
+	else if (strncmp("ai-mcts", argv[5], 7) == 0)
+	{
+		settings.p1NextMoveFn = [&](const State& state)
+				{ return nextMctsMove(settings, state); };
 	}
 	else
 	{
@@ -118,20 +359,24 @@ int main(int argc, char** argv)
 	// Get p2 settings
 	if (strncmp("human", argv[6], 5) == 0)
 	{
-		globalState().p2Heuristic = nullptr;
-		globalState().p2NextMoveFn = nextHumanMove;
+		settings.p2NextMoveFn = nextHumanMove;
 	}
 	else if (strncmp("ai-h1", argv[6], 5) == 0)
 	{
-		globalState().p2Heuristic = [](const State& state)
-				{ return calculateHeuristic1(state, false); };
-		globalState().p2NextMoveFn = nextAiMove;
+		settings.p2Heuristic = Heuristic::H1;
+		settings.p2NextMoveFn = [&](const State& state)
+				{ return nextAiMove(settings, state); };
 	}
 	else if (strncmp("ai-h2", argv[6], 5) == 0)
 	{
-		globalState().p2Heuristic = [](const State& state)
-				{ return calculateHeuristic2(state, false); };
-		globalState().p2NextMoveFn = nextAiMove;
+		settings.p2Heuristic = Heuristic::H2;
+		settings.p2NextMoveFn = [&](const State& state)
+				{ return nextAiMove(settings, state); };
+	}
+	else if (strncmp("ai-mcts", argv[6], 7) == 0)
+	{
+		settings.p2NextMoveFn = [&](const State& state)
+				{ return nextMctsMove(settings, state); };
 	}
 	else
 	{
@@ -142,11 +387,11 @@ int main(int argc, char** argv)
 	// Get whether we should apply iterative deepening
 	if (strncmp("true", argv[7], 4) == 0)
 	{
-		globalState().iterativeDeepening = true;
+		settings.iterativeDeepening = true;
 	}
 	else if (strncmp("false", argv[7], 5) == 0)
 	{
-		globalState().iterativeDeepening = false;
+		settings.iterativeDeepening = false;
 	}
 	else
 	{
@@ -154,8 +399,30 @@ int main(int argc, char** argv)
 		return 1;
 	}
 
+	// Get any optional settings
+	for (auto i = 8; i < argc; ++i)
+	{
+		if (!parseOption(settings, argv[i]))
+		{
+			usage();
+			return 1;
+		}
+	}
+	createSearchTables(settings);
+	if (!openSearchFiles(settings))
+	{
+		return 1;
+	}
+	if (settings.clockMilliseconds > 0
+			|| settings.moveMilliseconds > 0)
+	{
+		settings.timeManager = make_unique<TimeManager>(
+				settings.clockMilliseconds,
+				settings.moveMilliseconds);
+	}
+
 	// Create starting state
-	auto state = State{};
+	auto state = State{*settings.game};
 
 	// Main game loop
 	while (!state.isEndState())
@@ -164,14 +431,14 @@ int main(int argc, char** argv)
 		cout << endl;
 		if (state.getIsP1Turn())
 		{
-			globalState().currentHeuristic = globalState().p1Heuristic;
-			state = globalState().p1NextMoveFn(state);
+			settings.search.heuristic = settings.p1Heuristic;
+			state = settings.p1NextMoveFn(state);
 			assert(!state.getIsP1Turn());
 		}
 		else
 		{
-			globalState().currentHeuristic = globalState().p2Heuristic;
-			state = globalState().p2NextMoveFn(state);
+			settings.search.heuristic = settings.p2Heuristic;
+			state = settings.p2NextMoveFn(state);
 			assert(state.getIsP1Turn());
 		}
 	}
@@ -180,11 +447,11 @@ int main(int argc, char** argv)
 	cout << endl;
 	cout << endl;
 	cout << "GAME OVER" << endl;
-	if (state.p1Captures > state.p2Captures)
+	if (state.p1Captures() > state.p2Captures())
 	{
 		cout << "Player 1 wins" << endl;
 	}
-	else if (state.p1Captures < state.p2Captures)
+	else if (state.p1Captures() < state.p2Captures())
 	{
 		cout << "Player 2 wins" << endl;
 	}
@@ -196,9 +463,441 @@ int main(int argc, char** argv)
 	return 0;
 }
 
-State nextAiMove(const State& currentState)
+// Solves endgames offline: mancala tablebase [holes] [max-stones] [file]
+int tablebaseCommand(Settings& settings, int argc, char** argv)
+{
+	if (argc < 5)
+	{
+		usage();
+		return 1;
+	}
+
+	auto holes = -1;
+	stringstream{argv[2]} >> holes;
+	auto maxStones = -1;
+	stringstream{argv[3]} >> maxStones;
+	if (holes < 1 || holes > MAX_HOLES || maxStones < 0
+			|| maxStones > MAX_TABLEBASE_STONES)
+	{
+		usage();
+		return 1;
+	}
+	for (auto i = 5; i < argc; ++i)
+	{
+		if (!parseOption(settings, argv[i]))
+		{
+			usage();
+			return 1;
+		}
+	}
+	settings.game = make_unique<GameConfig>(settings.game->numStones, holes);
+
+	if (!generateTablebase(argv[4], *settings.game, maxStones,
+			settings.numThreads))
+	{
+		cerr << "Couldn't write " << argv[4] << endl;
+		return 1;
+	}
+	return 0;
+}
+
+// Builds an opening book: mancala book [turns] [depth] [file] [options]
+int bookCommand(Settings& settings, int argc, char** argv)
 {
-	assert(globalState().currentHeuristic != nullptr);
+	if (argc < 5)
+	{
+		usage();
+		return 1;
+	}
+
+	auto turns = -1;
+	stringstream{argv[2]} >> turns;
+	auto depth = -1;
+	stringstream{argv[3]} >> depth;
+	if (turns < 1 || depth < 1 || depth > MAX_SEARCH_DEPTH)
+	{
+		usage();
+		return 1;
+	}
+
+	auto configs = BookConfigs{};
+	auto heuristic = Heuristic::H2;
+	for (auto i = 5; i < argc; ++i)
+	{
+		auto option = string{argv[i]};
+		auto stones = -1;
+		auto holes = -1;
+		auto by = 'x';
+		if (option.compare(0, 5, "only=") == 0
+				&& stringstream{option.substr(5)} >> stones >> by >> holes
+				&& by == 'x' && stones >= 2 && stones <= MAX_STONES
+				&& holes >= stones - 1 && holes <= 2 * (stones - 1))
+		{
+			configs.emplace_back(stones, holes);
+		}
+		else if (option == "heuristic=h1")
+		{
+			heuristic = Heuristic::H1;
+		}
+		else if (option == "heuristic=h2")
+		{
+			heuristic = Heuristic::H2;
+		}
+		else if (!parseOption(settings, option))
+		{
+			usage();
+			return 1;
+		}
+	}
+	if (configs.empty())
+	{
+		// Every board size main() accepts
+		for (auto stones = 2; stones <= MAX_STONES; ++stones)
+		{
+			for (auto holes = stones - 1; holes <= 2 * (stones - 1); ++holes)
+			{
+				configs.emplace_back(stones, holes);
+			}
+		}
+	}
+	createSearchTables(settings);
+
+	if (!buildOpeningBook(settings.search, argv[4], configs, turns, depth,
+			heuristic))
+	{
+		cerr << "Couldn't write " << argv[4] << endl;
+		return 1;
+	}
+	return 0;
+}
+
+// Counts the game tree: mancala perft [stones] [holes] [depth] [options]
+int perftCommand(Settings& settings, int argc, char** argv)
+{
+	if (argc == 3 && strcmp(argv[2], "check") == 0)
+	{
+		return perftCheck() ? 0 : 1;
+	}
+	if (argc < 5)
+	{
+		usage();
+		return 1;
+	}
+
+	auto stones = -1;
+	stringstream{argv[2]} >> stones;
+	auto holes = -1;
+	stringstream{argv[3]} >> holes;
+	auto depth = -1;
+	stringstream{argv[4]} >> depth;
+	if (stones < 2 || stones > MAX_STONES || holes < stones - 1
+			|| holes > 2 * (stones - 1) || depth < 0)
+	{
+		usage();
+		return 1;
+	}
+	settings.game = make_unique<GameConfig>(stones, holes);
+
+	auto unit = PerftUnit::TURN;
+	auto bulk = true;
+	auto state = State{*settings.game};
+	for (auto i = 5; i < argc; ++i)
+	{
+		auto option = string{argv[i]};
+		if (option == "unit=turn" || option == "unit=move")
+		{
+			unit = option == "unit=turn" ? PerftUnit::TURN : PerftUnit::MOVE;
+		}
+		else if (option == "bulk=true" || option == "bulk=false")
+		{
+			bulk = option == "bulk=true";
+		}
+		else if (option.compare(0, 5, "from=") == 0)
+		{
+			if (!parseState(*settings.game, option.substr(5), state))
+			{
+				cerr << "Can't read state " << option.substr(5) << endl;
+				return 1;
+			}
+		}
+		else if (!parseOption(settings, option))
+		{
+			usage();
+			return 1;
+		}
+	}
+	if (settings.numThreads > 1)
+	{
+		settings.threadPool =
+				make_unique<ThreadPool>(settings.numThreads);
+	}
+
+	perftDivide(state, depth, unit, bulk, settings.threadPool.get());
+	return 0;
+}
+
+// Plays the AI against itself without printing the games:
+// mancala selfplay [stones] [holes] [depth] [games] [file] [options]
+int selfPlayCommand(Settings& settings, int argc, char** argv)
+{
+	if (argc < 7)
+	{
+		usage();
+		return 1;
+	}
+
+	auto stones = -1;
+	stringstream{argv[2]} >> stones;
+	auto holes = -1;
+	stringstream{argv[3]} >> holes;
+	auto selfPlay = SelfPlaySettings{};
+	selfPlay.depth = -1;
+	stringstream{argv[4]} >> selfPlay.depth;
+	selfPlay.games = -1;
+	stringstream{argv[5]} >> selfPlay.games;
+	if (stones < 2 || stones > MAX_STONES || holes < stones - 1
+			|| holes > 2 * (stones - 1) || selfPlay.depth < 1
+			|| selfPlay.depth > MAX_SEARCH_DEPTH || selfPlay.games < 1)
+	{
+		usage();
+		return 1;
+	}
+	settings.game = make_unique<GameConfig>(stones, holes);
+
+	selfPlay.randomTurns = 2;
+	selfPlay.workers = max(1u, thread::hardware_concurrency());
+	selfPlay.seed = 1;
+	selfPlay.p1 = Heuristic::H1;
+	selfPlay.p2 = Heuristic::H2;
+	for (auto i = 7; i < argc; ++i)
+	{
+		auto option = string{argv[i]};
+		auto value = option.substr(option.find('=') + 1);
+		auto number = -1LL;
+		auto isNumber = static_cast<bool>(stringstream{value} >> number);
+		if (option == "p1=h1" || option == "p1=h2")
+		{
+			selfPlay.p1 = value == "h1" ? Heuristic::H1 : Heuristic::H2;
+		}
+		else if (option == "p2=h1" || option == "p2=h2")
+		{
+			selfPlay.p2 = value == "h1" ? Heuristic::H1 : Heuristic::H2;
+		}
+		else if (option.compare(0, 7, "random=") == 0 && isNumber
+				&& number >= 0 && number <= MAX_RANDOM_TURNS)
+		{
+			selfPlay.randomTurns = number;
+		}
+		else if (option.compare(0, 5, "seed=") == 0 && isNumber
+				&& number >= 0)
+		{
+			selfPlay.seed = number;
+		}
+		else if (option.compare(0, 8, "workers=") == 0 && isNumber
+				&& number >= 1)
+		{
+			selfPlay.workers = number;
+		}
+		else if (!parseOption(settings, option))
+		{
+			usage();
+			return 1;
+		}
+	}
+	selfPlay.workers = min(selfPlay.workers, selfPlay.games);
+	if (!openSearchFiles(settings))
+	{
+		return 1;
+	}
+	selfPlay.tableMegabytes = settings.tableMegabytes;
+	selfPlay.tableReplacement = settings.tableReplacement;
+	selfPlay.moveOrdering = settings.search.moveOrdering;
+	selfPlay.algorithm = settings.search.algorithm;
+	selfPlay.tablebase = settings.tablebase.get();
+	selfPlay.openingBook = settings.openingBook.get();
+
+	if (!playSelfPlayGames(argv[6], *settings.game, selfPlay))
+	{
+		cerr << "Couldn't write " << argv[6] << endl;
+		return 1;
+	}
+	return 0;
+}
+
+// Searches a file of positions:
+// mancala analyze [stones] [holes] [depth] [file] [options]
+int analyzeCommand(Settings& settings, int argc, char** argv)
+{
+	if (argc < 6)
+	{
+		usage();
+		return 1;
+	}
+
+	auto stones = -1;
+	stringstream{argv[2]} >> stones;
+	auto holes = -1;
+	stringstream{argv[3]} >> holes;
+	auto analysis = AnalysisSettings{};
+	analysis.depth = -1;
+	stringstream{argv[4]} >> analysis.depth;
+	if (stones < 2 || stones > MAX_STONES || holes < stones - 1
+			|| holes > 2 * (stones - 1) || analysis.depth < 1
+			|| analysis.depth > MAX_SEARCH_DEPTH)
+	{
+		usage();
+		return 1;
+	}
+	settings.game = make_unique<GameConfig>(stones, holes);
+
+	analysis.workers = max(1u, thread::hardware_concurrency());
+	analysis.heuristic = Heuristic::H2;
+	auto outPath = string{};
+	for (auto i = 6; i < argc; ++i)
+	{
+		auto option = string{argv[i]};
+		auto workers = -1;
+		if (option.compare(0, 4, "out=") == 0 && option.size() > 4)
+		{
+			outPath = option.substr(4);
+		}
+		else if (option == "heuristic=h1" || option == "heuristic=h2")
+		{
+			analysis.heuristic = option == "heuristic=h1" ? Heuristic::H1
+					: Heuristic::H2;
+		}
+		else if (option.compare(0, 8, "workers=") == 0
+				&& stringstream{option.substr(8)} >> workers && workers >= 1)
+		{
+			analysis.workers = workers;
+		}
+		else if (!parseOption(settings, option))
+		{
+			usage();
+			return 1;
+		}
+	}
+	if (!openSearchFiles(settings))
+	{
+		return 1;
+	}
+	analysis.moveMilliseconds = settings.moveMilliseconds;
+	analysis.tableMegabytes = settings.tableMegabytes;
+	analysis.tableReplacement = settings.tableReplacement;
+	analysis.moveOrdering = settings.search.moveOrdering;
+	analysis.algorithm = settings.search.algorithm;
+	analysis.tablebase = settings.tablebase.get();
+
+	auto scored = unique_ptr<PositionWriter>{};
+	if (!outPath.empty())
+	{
+		scored = make_unique<PositionWriter>(outPath, *settings.game);
+		analysis.scored = scored.get();
+	}
+
+	const auto start = chrono::steady_clock::now();
+	auto totals = AnalysisTotals{};
+	auto file = ifstream{};
+	PositionFile positions;
+	if (strcmp(argv[5], "-") == 0)
+	{
+		totals = analyzePositions(cin, cout, *settings.game, analysis);
+	}
+	else if (isPositionFile(argv[5]))
+	{
+		if (!positions.open(argv[5]) || positions.getStones() != stones
+				|| positions.getHoles() != holes)
+		{
+			cerr << "Can't read " << argv[5] << " for " << stones
+					<< " stones and " << holes << " holes" << endl;
+			return 1;
+		}
+		totals = analyzePositions(positions, cout, *settings.game, analysis);
+	}
+	else
+	{
+		file.open(argv[5]);
+		if (!file)
+		{
+			cerr << "Can't read " << argv[5] << endl;
+			return 1;
+		}
+		totals = analyzePositions(file, cout, *settings.game, analysis);
+	}
+	if (scored && !scored->close())
+	{
+		cerr << "Couldn't write " << outPath << endl;
+		return 1;
+	}
+	const auto elapsed = chrono::duration<double>(
+			chrono::steady_clock::now() - start).count();
+	cerr << totals.positions << " positions in " << elapsed << " s, "
+			<< totals.nodesExpanded << " nodes";
+	if (totals.unreadable > 0)
+	{
+		cerr << ", " << totals.unreadable << " unreadable";
+	}
+	cerr << endl;
+	return totals.unreadable > 0 ? 1 : 0;
+}
+
+// Opens the tablebase, opening book and statistics file the options asked
+// for. Returns false, after saying why, if any of them can't be used.
+bool openSearchFiles(Settings& settings)
+{
+	if (!settings.tablebasePath.empty())
+	{
+		settings.tablebase = make_unique<Tablebase>();
+		if (!settings.tablebase->open(settings.tablebasePath,
+				settings.game->numHoles))
+		{
+			cerr << "Can't use tablebase " << settings.tablebasePath
+					<< " for " << settings.game->numHoles << " holes" << endl;
+			return false;
+		}
+		settings.search.tablebase = settings.tablebase.get();
+	}
+	if (!settings.bookPath.empty())
+	{
+		settings.openingBook = make_unique<OpeningBook>();
+		if (!settings.openingBook->open(settings.bookPath))
+		{
+			cerr << "Can't use opening book " << settings.bookPath << endl;
+			return false;
+		}
+	}
+	if (!settings.statsPath.empty())
+	{
+		settings.statsFile = make_unique<ofstream>(settings.statsPath);
+		if (!*settings.statsFile)
+		{
+			cerr << "Can't write statistics to " << settings.statsPath
+					<< endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+// Sets up the transposition table and thread pool the options asked for
+void createSearchTables(Settings& settings)
+{
+	if (settings.tableMegabytes > 0)
+	{
+		settings.transpositionTable = make_unique<TranspositionTable>(
+				settings.tableMegabytes, settings.tableReplacement);
+		settings.search.transpositionTable = settings.transpositionTable.get();
+	}
+	if (settings.numThreads > 1)
+	{
+		settings.threadPool = make_unique<ThreadPool>(settings.numThreads);
+		settings.search.threadPool = settings.threadPool.get();
+	}
+}
+
+State nextAiMove(Settings& settings, const State& currentState)
+{
+	auto& context = settings.search;
 
 	// Show the current state so the user knows what's going on
 	cout << "AI's turn" << endl;
@@ -212,72 +911,123 @@ State nextAiMove(const State& currentState)
 	}
 	currentState.prettyPrint(cout);
 
+	// Opening positions may have been searched ahead of time, the same way
+	// as this player would. On a clock there's no one depth to match.
+	auto bestMove = MoveSequence{};
+	auto book = settings.openingBook.get();
+	auto bookDepth = settings.timeManager ? 0 : settings.searchDepth;
+	auto fromBook = book && book->lookup(currentState, context.heuristic,
+			bookDepth, bestMove);
+	if (fromBook)
+	{
+		cout << "AI found this position in the opening book" << endl;
+	}
+
 	// Collect some data for analysis later
-	int numNodesExpanded = 1;
-	globalState().prunedNodes = 0;
+	int numNodesExpanded = fromBook ? 0 : 1;
+	auto stats = SearchStats{};
+
+	// Table entries from the other player's searches don't apply to us
+	if (context.transpositionTable)
+	{
+		context.transpositionTable->newSearch();
+	}
+
+	// Likewise for killer moves and history scores
+	context.searchId += 1;
+
+	// With a time budget, deepen until it runs out
+	auto timeManager = settings.timeManager.get();
+	auto start = TimeManager::Clock::now();
+	auto budget = timeManager ? timeManager->budgetFor(currentState)
+			: TimeManager::Milliseconds{0};
+	auto maxDepth = fromBook ? 0
+			: timeManager ? MAX_SEARCH_DEPTH : settings.searchDepth;
 
 	// Initialize things for iterative deepening
-	auto fringe = stack<Node>{};
 	auto bestValue = -9999999999;
-	auto bestMove = queue<Move>{};
-	auto depth = !globalState().iterativeDeepening
-			? globalState().searchDepth : 1;
+	auto guess = NO_GUESS; // the last iteration's value, for aspiration
+	auto depth = !settings.iterativeDeepening && !timeManager
+			? settings.searchDepth : 1;
 
-	for (; depth <= globalState().searchDepth; ++depth)
+	for (; depth <= maxDepth; ++depth)
 	{
-		// Initialize the fringe with the root node
-		fringe.emplace(Node{currentState, depth, true});
-
-		// Search through the game tree to find the best move
-		while (!fringe.empty())
+		if (timeManager)
 		{
-			//cout << "AI is evaluating move " << fringe.top() << endl;
-
-			if (fringe.top().hasNextNode())
+			// Each iteration takes longer than all the earlier ones put
+			// together, so don't start one we're unlikely to finish
+			auto elapsed = TimeManager::Clock::now() - start;
+			if (depth > 1 && elapsed * 2 > budget)
 			{
-				numNodesExpanded += 1;
-
-				// Expand the next node, and make that the top of the stack
-				fringe.top().expandNextNode(fringe);
-				// Following ordinary stack rules, we can only ever operate on the
-				// top element, so go back to the start of the loop.
+				break;
 			}
-			else
+			setSearchDeadline(context, start + budget);
+		}
+
+		// Search through the game tree to find the best move
+		auto iterationStart = chrono::steady_clock::now();
+		auto result = searchToDepth(context, currentState, depth, guess);
+		auto seconds = chrono::duration<double>(
+				chrono::steady_clock::now() - iterationStart).count();
+		numNodesExpanded += result.nodesExpanded;
+		stats += result.stats;
+		if (settings.statsFile)
+		{
+			writeSearchStats(*settings.statsFile, currentState, depth,
+					result, seconds);
+		}
+		if (!result.complete)
+		{
+			// A partly searched iteration is only better than nothing
+			cout << "depth=" << depth << " ran out of time" << endl;
+			if (bestMove.empty())
 			{
-				// This section applies to nodes that have no children, either
-				// because we've maxed out the depth of our search, or because
-				// we've already evaluated all the children.
-				if (fringe.size() > 1)
-				{
-					// Evaluate the node and update its parents
-					fringe.top().updateParent();
-					fringe.pop();
-				}
-				else
-				{
-					// We're at the root node now, so end the loop
-					// If you pop the root, you won't be able to retrieve its data
-					break;
-				}
+				bestMove = result.bestMove;
 			}
+			break;
 		}
 
 		cout << "depth=" << depth << ", bestValue=" << bestValue << "bestMove=";
 		printMoves(bestMove);
 		cout << endl;
-		cout << "depth=" << depth << ", currentValue=" << fringe.top().getValue() << "currentMove=";
-		printMoves(fringe.top().getBestMove());
+		cout << "depth=" << depth << ", currentValue=" << result.value << "currentMove=";
+		printMoves(result.bestMove);
 		cout << endl;
+		if (result.passes > 1)
+		{
+			cout << "depth=" << depth << " searched the root "
+					<< result.passes << " times" << endl;
+		}
+		printSearchStats(depth, result, seconds);
+		guess = result.value;
 
 		// Use iterative deepening for move order
-		if (fringe.top().getValue() != bestValue)
+		if (result.value != bestValue)
 		{
-			bestValue = fringe.top().getValue();
-			bestMove = fringe.top().getBestMove();
+			bestValue = result.value;
+			bestMove = result.bestMove;
 		}
+	}
 
-		fringe.pop();
-		assert(fringe.empty());
+	clearSearchDeadline(context);
+	if (bestMove.empty())
+	{
+		// Out of time before a single move was looked at
+		bestMove = searchToDepth(context, currentState, 1).bestMove;
+	}
+	if (timeManager)
+	{
+		auto used = std::chrono::duration_cast<TimeManager::Milliseconds>(
+				TimeManager::Clock::now() - start);
+		timeManager->charge(currentState, used);
+		cout << "AI used " << used.count() << " of " << budget.count()
+				<< " ms budgeted";
+		if (settings.clockMilliseconds > 0)
+		{
+			cout << ", " << timeManager->remaining(currentState).count()
+					<< " ms left";
+		}
+		cout << endl;
 	}
 
 	// Apply the best move
@@ -286,12 +1036,127 @@ State nextAiMove(const State& currentState)
 
 	// Print the performance data we collected
 	cout << "AI looked at " << numNodesExpanded << " nodes ("
-					<< globalState().prunedNodes << " pruned)" << endl;
+					<< stats.betaCutoffs << " cutoffs)" << endl;
 
 	// Note that because newState indicates it's the other player's turn now,
 	// you have to tell it to maximize for the opposite player.
 	cout << "Heuristic rates this state as "
-			<< globalState().currentHeuristic(newState) << endl;
+			<< evaluate(context.heuristic, newState,
+					currentState.getIsP1Turn()) << endl;
+	return newState;
+}
+
+// The effective branching factor: the turns per position that it would
+// take to search as many nodes with no pruning or table
+double branchingFactor(const SearchStats& stats, int depth)
+{
+	return pow(static_cast<double>(stats.turns), 1.0 / depth);
+}
+
+// Prints what one iteration of the AI's search cost and how well it pruned
+void printSearchStats(int depth, const SearchResult& result, double seconds)
+{
+	const auto& stats = result.stats;
+	cout << "depth=" << depth << " took " << lround(seconds * 1000)
+			<< " ms: " << result.nodesExpanded << " nodes";
+	if (seconds > 0)
+	{
+		cout << " (" << lround(result.nodesExpanded / seconds) << "/s)";
+	}
+	cout << ", branching " << branchingFactor(stats, depth) << ", "
+			<< stats.betaCutoffs << " cutoffs";
+	if (stats.betaCutoffs > 0)
+	{
+		cout << " (" << 100 * stats.firstMoveCutoffs / stats.betaCutoffs
+				<< "% on the first move)";
+	}
+	cout << ", " << stats.leafEvaluations << " leaves";
+	if (stats.turns > 0)
+	{
+		cout << ", " << static_cast<double>(stats.sowings) / stats.turns
+				<< " sowings per turn (longest " << stats.longestTurn << ")";
+	}
+	cout << endl;
+}
+
+// Writes the same as a line of JSON, for the stats= option
+void writeSearchStats(ostream& stream, const State& state, int depth,
+		const SearchResult& result, double seconds)
+{
+	const auto& stats = result.stats;
+	stream << "{\"position\":\"" << state << "\",\"player\":"
+			<< (state.getIsP1Turn() ? 1 : 2) << ",\"depth\":" << depth
+			<< ",\"complete\":" << (result.complete ? "true" : "false")
+			<< ",\"value\":" << result.value
+			<< ",\"seconds\":" << seconds
+			<< ",\"nodes\":" << result.nodesExpanded
+			<< ",\"nodesPerSecond\":"
+			<< (seconds > 0 ? lround(result.nodesExpanded / seconds) : 0)
+			<< ",\"branchingFactor\":" << branchingFactor(stats, depth)
+			<< ",\"betaCutoffs\":" << stats.betaCutoffs
+			<< ",\"firstMoveCutoffs\":" << stats.firstMoveCutoffs
+			<< ",\"leafEvaluations\":" << stats.leafEvaluations
+			<< ",\"turns\":" << stats.turns
+			<< ",\"sowings\":" << stats.sowings
+			<< ",\"longestTurn\":" << stats.longestTurn
+			<< ",\"nodesAtPly\":[";
+	for (auto ply = 1; ply <= depth && ply <= MAX_SEARCH_DEPTH; ++ply)
+	{
+		stream << (ply > 1 ? "," : "") << stats.nodesAtPly[ply];
+	}
+	stream << "]}" << endl;
+}
+
+// Plays a turn found by Monte Carlo tree search. The search only sees so
+// far into a chain of bonus moves, so a long turn may take a few of them.
+State nextMctsMove(Settings& settings, const State& currentState)
+{
+	auto& context = settings.search;
+
+	cout << "AI's turn" << endl;
+	if (currentState.getIsP1Turn())
+	{
+		cout << "AI is Player 1 (top)" << endl;
+	}
+	else
+	{
+		cout << "AI is Player 2 (bottom)" << endl;
+	}
+	currentState.prettyPrint(cout);
+
+	// Opening books are searched with a heuristic, which this player
+	// doesn't have, so it never uses one
+	auto newState = currentState;
+	auto timeManager = settings.timeManager.get();
+	auto start = TimeManager::Clock::now();
+	auto budget = timeManager ? timeManager->budgetFor(currentState)
+			: TimeManager::Milliseconds{0};
+	while (newState.getIsP1Turn() == currentState.getIsP1Turn())
+	{
+		if (timeManager)
+		{
+			// Keep a quarter back for any bonus moves still to search
+			auto now = TimeManager::Clock::now();
+			setSearchDeadline(context, now + (start + budget - now) * 3 / 4);
+		}
+		auto result = searchMonteCarlo(context, newState,
+				timeManager ? 0 : settings.playouts);
+		cout << "AI played out " << result.playouts << " games over "
+				<< result.treeNodes << " nodes; " << result.moves.front()
+				<< " won " << static_cast<int>(100 * result.winRate + 0.5)
+				<< "% of its games" << endl;
+		applyAndPrintMoves(newState, result.moves);
+	}
+
+	clearSearchDeadline(context);
+	if (timeManager)
+	{
+		auto used = std::chrono::duration_cast<TimeManager::Milliseconds>(
+				TimeManager::Clock::now() - start);
+		timeManager->charge(currentState, used);
+		cout << "AI used " << used.count() << " of " << budget.count()
+				<< " ms budgeted" << endl;
+	}
 	return newState;
 }
 
@@ -326,7 +1191,8 @@ State nextHumanMove(const State& currentState)
 		auto move = -1;
 		auto clockwise = true;
 		auto validDir = false;
-		while (move < 1 || move > globalState().numHoles || !validDir)
+		const auto numHoles = currentState.getConfig().numHoles;
+		while (move < 1 || move > numHoles || !validDir)
 		{
 			// Reset the loop conditions
 			move = -1;
@@ -334,7 +1200,7 @@ State nextHumanMove(const State& currentState)
 
 			// Get the move number
 			cout << "Select one of your holes (range is 1 - "
-					<< globalState().numHoles << ")" << endl;
+					<< numHoles << ")" << endl;
 			auto input = string{};
 			getline(cin, input);
 			stringstream{input} >> move;
@@ -371,9 +1237,10 @@ State nextHumanMove(const State& currentState)
 
 void tests()
 {
+	const GameConfig game{4, 4};
 	auto p1Holes = vector<uint8_t>{0, 0, 6, 6};
 	auto p2Holes = vector<uint8_t>{4, 4, 5, 5};
-	auto startState = State{p1Holes, p2Holes, 2, false};
+	auto startState = State{game, p1Holes, p2Holes, 2, false};
 	auto s1 = stringstream{};
 	s1 << startState;
 	assert(s1.str() == "2/0,0,6,6/4,4,5,5/0*");
@@ -397,4 +1264,97 @@ void tests()
 	s1 = stringstream{};
 	s1 << s1AfterM2;
 	assert(s1.str() == "*2/1,1,7,6/0,4,5,5/1");
+
+	auto moves = MoveSequence{};
+	moves.push(m2);
+	moves.push(Move{4, false});
+	assert(moves.size() == 2 && moves[1].holeNumber == 4 && !moves[1].clockwise);
+	auto s1AfterMoves = startState;
+	applyMoves(s1AfterMoves, moves);
+	s1 = stringstream{};
+	s1 << s1AfterMoves;
+	assert(s1.str() == "3/2,2,8,0/1,5,5,5/1*");
+
+	// The incrementally updated hash and stone counts must agree with a
+	// full recompute
+	auto rehashed = s1AfterM2;
+	rehashed.rehash();
+	assert(rehashed.getHash() == s1AfterM2.getHash());
+	assert(rehashed.holeStones[0] == s1AfterM2.holeStones[0]);
+	assert(rehashed.holeStones[1] == s1AfterM2.holeStones[1]);
+	assert(s1AfterM1.getHash() != s1AfterM2.getHash());
+
+	// A position must come back from its binary record unchanged
+	auto record = PositionRecord{};
+	storePosition(s1AfterM2, record);
+	auto loaded = startState;
+	assert(loadPosition(record, loaded));
+	assert(loaded.getHash() == s1AfterM2.getHash());
+	assert(equal(begin(loaded.board), end(loaded.board),
+			begin(s1AfterM2.board)));
+
+	// Records that can't be a position on the board are turned away
+	auto corrupt = PositionRecord{};
+	storePosition(startState, corrupt);
+	corrupt.board[P1_HOLES] += 1;
+	assert(!loadPosition(corrupt, loaded));
+	corrupt.board[P1_HOLES] -= 2;
+	corrupt.board[P1_HOLES + game.numHoles] += 1;
+	assert(!loadPosition(corrupt, loaded));
+	storePosition(startState, corrupt);
+	corrupt.flags |= 0x80;
+	assert(!loadPosition(corrupt, loaded));
+	assert(loaded.getHash() == s1AfterM2.getHash());
+
+	// Sowing more than a lap must drop the stones where HoleIterator would
+	auto lapped = State{game, {23, 0, 0, 0}, {1, 1, 1, 1}, 3, true};
+	auto walked = lapped;
+	auto walk = HoleIterator{Move{1, false}, walked};
+	for (auto stones = exchange(*walk, 0); stones > 0; --stones)
+	{
+		walk.next();
+		*walk += 1;
+	}
+	applyMove(lapped, Move{1, false});
+	assert(equal(begin(lapped.board), end(lapped.board), begin(walked.board)));
+	walked.rehash();
+	assert(lapped.hash == walked.hash);
+	assert(lapped.holeStones[0] == walked.holeStones[0]);
+
+	// 30 stones left is about 7 more moves each, so a seventh of the clock
+	auto clock = TimeManager{1000, 0};
+	assert(clock.budgetFor(startState).count() == 142);
+	clock.charge(startState, TimeManager::Milliseconds{142});
+	assert(clock.remaining(startState).count() == 858);
+	assert(clock.remaining(s1AfterM2).count() == 1000);
+	assert(TimeManager(1000, 50).budgetFor(startState).count() == 50);
+	assert(TimeManager(0, 50).budgetFor(startState).count() == 50);
+
+	// Tablebase positions must be numbered 0, 1, 2, ... with no gaps
+	auto tablebaseIndex = TablebaseIndex{game.numHoles, 3};
+	assert(tablebaseIndex.layerSize(3) == 120);
+	auto spread = State{game};
+	for (uint64_t rank = 0; rank < tablebaseIndex.layerSize(3); ++rank)
+	{
+		tablebaseIndex.setHoles(spread, 3, rank);
+		assert(spread.getUncaptured() == 3);
+		assert(tablebaseIndex.rankOf(spread, 3) == rank);
+	}
+
+	// A tablebase result that never ends gets no bonus for ending the game,
+	// whatever its lead, unlike one that captures everything
+	assert(solvedHeuristic1(spread, 0, false, true) == 0);
+	assert(solvedHeuristic1(spread, 2, false, true) == 4);
+	assert(solvedHeuristic1(spread, 1, true, true) == 402);
+	assert(solvedHeuristic1(spread, -3, true, false) == 406);
+	assert(solvedHeuristic2(spread, 0, false, false) == 0);
+
+	// States read back the way they are printed
+	auto parsed = State{game};
+	assert(parseState(game, "2/0,0,6,6/4,4,5,5/0*", parsed));
+	assert(parsed.getHash() == startState.getHash());
+	assert(!parseState(game, "2/0,0,6,6/4,4,5,5/0", parsed));
+	// Counts that only add up once they wrap round a byte don't
+	assert(!parseState(game, "*16/120,120,16,0/4,4,4,4/0", parsed));
+	assert(!parseState(game, "*272/0,0,0,0/4,4,4,4/0", parsed));
 }